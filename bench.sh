@@ -0,0 +1,178 @@
+#!/bin/bash
+# End-to-end benchmark of the plotter variants.
+# Every plotter reads the same data set from a pseudo terminal written by serial_generator at a fixed rate
+# and draws into an Xvfb display, so neither hardware nor a screen is needed.
+# Measured per plotter: the lines/s it consumed, CPU% and peak RSS, and the frame timings and latency where the plotter reports them.
+# The results are written as JSON, so runs can be compared by a script.
+
+DURATION=10 # seconds of data sent to each plotter
+RATE=1000 # lines per second
+BAUD= # pace to a UART byte rate instead of a line rate
+FIELDS=4 # data fields per line, taken from the recording when there is one
+RECORDING= # recorded data set replayed by the generator
+REPORT=bench_report.json
+BUILD_DIR=_bench
+BINARY_DIR= # run the plotters already built there (e.g. build/pgo by the Makefile) instead of building them
+
+usage() {
+    echo "Usage: $0 [-d <seconds>] [-r <lines per second>] [-b <baud rate>] [-f <number of data fields>] [-i <recorded data>] [-o <report file>] [-B <binary directory>] [plotter ...]" >&2
+    echo "       plotters: serial_plotter resize_graph event_serial_plotter big_margin pthread_serial (default all)" >&2
+    exit 1
+}
+
+while getopts "d:r:b:f:i:o:B:" option; do
+    case $option in
+        d) DURATION=$OPTARG ;;
+        r) RATE=$OPTARG ;;
+        b) BAUD=$OPTARG ;;
+        f) FIELDS=$OPTARG ;;
+        i) RECORDING=$OPTARG ;;
+        o) REPORT=$OPTARG ;;
+        B) BINARY_DIR=$OPTARG ;;
+        *) usage ;;
+    esac
+done
+shift $((OPTIND - 1))
+PLOTTERS=${*:-serial_plotter resize_graph event_serial_plotter big_margin pthread_serial}
+
+# The generator replaces the timestamps of the recording, the number of fields comes from its first line
+# The timestamps are CLOCK_MONOTONIC micros(), they are the markers of the event plotter's latency measurement
+GENERATOR_OPTIONS="-u -r $RATE"
+if [ -n "$BAUD" ]; then
+    GENERATOR_OPTIONS="-u -b $BAUD"
+fi
+if [ -n "$RECORDING" ]; then
+    GENERATOR_OPTIONS="$GENERATOR_OPTIONS -i $RECORDING"
+    FIELDS=$(head -n 1 "$RECORDING" | tr -cd ',' | wc -c)
+fi
+LINES=$((RATE * DURATION))
+
+# A function to print the source files and libraries of a plotter
+plotter_build() {
+    case $1 in
+        serial_plotter) echo "serial_plotter.c -lX11" ;;
+        resize_graph) echo "serial_plotter_resize.c -lX11" ;;
+        event_serial_plotter) echo "serial_plotter_resize_event.c plotter_core.c gl_renderer.c -lX11 -lGL -lev -lm -lpthread" ;;
+        big_margin) echo "serial_plotter_resize_event_big_margin.c -lX11 -lev" ;;
+        pthread_serial) echo "pthread_serial.c -lX11 -lpthread" ;;
+        *) echo "Error: Unknown plotter $1" >&2; usage ;;
+    esac
+}
+
+# A function to print the command line arguments of a plotter reading the given device
+plotter_args() {
+    case $1 in
+        serial_plotter) echo "$2 9600" ;;
+        event_serial_plotter) echo "-p -M 0 $2 $FIELDS:us" ;; # -p prints the frame timings, -M the latencies on exit
+        *) echo "$2 $FIELDS" ;;
+    esac
+}
+
+# A function to print a number as JSON, null if it is empty
+json_number() {
+    echo "${1:-null}"
+}
+
+mkdir -p $BUILD_DIR
+
+# Start a private Xvfb display, an existing display is only used when Xvfb is not installed
+XVFB_PID=
+if command -v Xvfb > /dev/null; then
+    DISPLAY_NUMBER=99
+    while [ -e /tmp/.X$DISPLAY_NUMBER-lock ]; do
+        DISPLAY_NUMBER=$((DISPLAY_NUMBER + 1))
+    done
+    Xvfb :$DISPLAY_NUMBER -screen 0 1024x768x24 -nolisten tcp > $BUILD_DIR/xvfb.log 2>&1 &
+    XVFB_PID=$!
+    export DISPLAY=:$DISPLAY_NUMBER
+    for i in $(seq 50); do
+        [ -e /tmp/.X11-unix/X$DISPLAY_NUMBER ] && break
+        sleep 0.1
+    done
+elif [ -n "$DISPLAY" ]; then
+    echo "Warning: Xvfb not found, drawing on $DISPLAY, the compositor is part of the results" >&2
+else
+    echo "Error: Xvfb not found and no DISPLAY set" >&2
+    exit 1
+fi
+trap '[ -n "$XVFB_PID" ] && kill $XVFB_PID 2> /dev/null' EXIT
+
+gcc -O2 serial_generator.c -o $BUILD_DIR/serial_generator -lm || exit 1
+
+CLOCK_TICKS=$(getconf CLK_TCK)
+RESULTS=()
+for name in $PLOTTERS; do
+    [ -z "$BINARY_DIR" ] && echo "$name: building" >&2
+    status=ok
+    lines_per_s= ; bytes_per_s= ; cpu_percent= ; max_rss_kb= ; frame_p50= ; frame_p99= ; draw_p50= ; draw_p99= ; latency_p50= ; latency_p99=
+    plotter=$BUILD_DIR/$name
+    if [ -n "$BINARY_DIR" ]; then
+        plotter=$BINARY_DIR/$name
+        [ -x $plotter ] || status="not built"
+    elif ! gcc -O2 $(plotter_build $name) -o $plotter > $BUILD_DIR/$name.build.log 2>&1; then
+        status="build failed"
+    fi
+    if [ "$status" = ok ]; then
+        echo "$name: $LINES lines at $GENERATOR_OPTIONS" >&2
+        device=$BUILD_DIR/tty_$name
+        $BUILD_DIR/serial_generator $GENERATOR_OPTIONS -f $FIELDS -n $LINES -s $device > /dev/null 2> $BUILD_DIR/$name.generator.log &
+        generator=$!
+        for i in $(seq 50); do
+            [ -e $device ] && break
+            sleep 0.1
+        done
+        $plotter $(plotter_args $name $device) > $BUILD_DIR/$name.log 2>&1 &
+        pid=$!
+        start=$(date +%s.%N)
+        ticks_start=$(awk '{print $14 + $15}' /proc/$pid/stat 2> /dev/null)
+
+        # the generator ends once the plotter consumed every line, or when it stopped reading for 5 s
+        wait $generator
+        end=$(date +%s.%N)
+        if [ -e /proc/$pid/stat ]; then
+            ticks_end=$(awk '{print $14 + $15}' /proc/$pid/stat)
+            max_rss_kb=$(awk '/^VmHWM/ {print $2}' /proc/$pid/status)
+            cpu_percent=$(echo "$ticks_start $ticks_end $start $end $CLOCK_TICKS" | awk '{printf "%.1f", ($2 - $1) / $5 / ($4 - $3) * 100}')
+            kill -TERM $pid 2> /dev/null
+            for i in $(seq 20); do
+                kill -0 $pid 2> /dev/null || break
+                sleep 0.1
+            done
+            kill -KILL $pid 2> /dev/null
+        else
+            status="exited early"
+        fi
+        wait $pid 2> /dev/null
+
+        # "N lines, B bytes in T s: L lines/s, B bytes/s" from the generator, "perf <stage>: p50 X us, p99 Y us" from the plotter
+        lines_per_s=$(awk '/lines\/s/ {print $(NF - 3)}' $BUILD_DIR/$name.generator.log)
+        bytes_per_s=$(awk '/lines\/s/ {print $(NF - 1)}' $BUILD_DIR/$name.generator.log)
+        if grep -q "stopped reading" $BUILD_DIR/$name.generator.log; then
+            status="stopped reading"
+        fi
+        frame_p50=$(awk '/^perf frame interval:/ {print $5}' $BUILD_DIR/$name.log)
+        frame_p99=$(awk '/^perf frame interval:/ {print $8}' $BUILD_DIR/$name.log)
+        draw_p50=$(awk '/^perf draw:/ {print $4}' $BUILD_DIR/$name.log)
+        draw_p99=$(awk '/^perf draw:/ {print $7}' $BUILD_DIR/$name.log)
+        # "latency send to present: N data points, min X ms, p50 X ms, p99 X ms, max X ms"
+        latency_p50=$(awk '/^latency send to present:/ {print $12}' $BUILD_DIR/$name.log)
+        latency_p99=$(awk '/^latency send to present:/ {print $15}' $BUILD_DIR/$name.log)
+    fi
+    echo "$name: $status, ${lines_per_s:--} lines/s, ${cpu_percent:--} % CPU, ${max_rss_kb:--} kB RSS" >&2
+    RESULTS+=("    {\"plotter\": \"$name\", \"status\": \"$status\", \"lines_per_s\": $(json_number $lines_per_s), \"bytes_per_s\": $(json_number $bytes_per_s), \"cpu_percent\": $(json_number $cpu_percent), \"max_rss_kb\": $(json_number $max_rss_kb), \"frame_interval_p50_us\": $(json_number $frame_p50), \"frame_interval_p99_us\": $(json_number $frame_p99), \"draw_p50_us\": $(json_number $draw_p50), \"draw_p99_us\": $(json_number $draw_p99), \"latency_p50_ms\": $(json_number $latency_p50), \"latency_p99_ms\": $(json_number $latency_p99)}")
+done
+
+{
+    echo "{"
+    echo "  \"date\": \"$(date -u +%Y-%m-%dT%H:%M:%SZ)\", \"commit\": \"$(git rev-parse --short HEAD 2> /dev/null)\","
+    echo "  \"duration_s\": $DURATION, \"lines\": $LINES, \"rate_lines_per_s\": $RATE, \"baud\": $(json_number $BAUD), \"fields\": $FIELDS, \"recording\": \"$RECORDING\", \"binaries\": \"${BINARY_DIR:-$BUILD_DIR}\","
+    echo "  \"results\": ["
+    for i in "${!RESULTS[@]}"; do
+        [ $i -gt 0 ] && echo ","
+        echo -n "${RESULTS[$i]}"
+    done
+    echo
+    echo "  ]"
+    echo "}"
+} > $REPORT
+echo "Report written to $REPORT" >&2
@@ -0,0 +1,667 @@
+// Microbenchmarks of the hot functions of the plotter core, each one run on its own over fixed synthetic inputs:
+// the line framer, the CSV parser, the min/max search of update_graph(), the coordinate math and decimation of draw_pane()
+// and the ways of submitting the lines to the X server.
+// With -g a frame of the Xlib render backend is compared with one of the OpenGL backend (gl_renderer.c), each streaming new data points.
+// With -e the OpenGL frames are run without a display, in an off-screen framebuffer of a surfaceless EGL context (Mesa llvmpipe).
+// The plotter core is linked in, so the benchmarks time exactly the code the plotters run.
+// Every benchmark is calibrated to run at least BENCH_MIN_TIME per repetition, warmed up and repeated, the median is reported.
+// With -i the serial input is a recorded data set instead of synthetic lines, this is also the PGO training run of the Makefile.
+// malloc, calloc and realloc are counted for every kernel: the core kernels must not allocate per sample, the program fails if they do.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <X11/Xlib.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include "plotter_core.h"
+#include "gl_renderer.h"
+
+#define BENCH_REPETITIONS 15 // timed repetitions of each benchmark, the median is reported
+#define BENCH_WARMUP 3 // untimed repetitions before the timed ones
+#define BENCH_MIN_TIME 20000000 // nanoseconds one repetition runs at least, short kernels are called in a loop
+#define BENCH_INPUT_LINES 4096 // lines of the synthetic serial input
+#define BENCH_WIDTH 800 // width of the window the points are transformed for, like the plotter window
+#define BENCH_HEIGHT 600 // height of that window
+#define BENCH_FRAME_POINTS 17 // data points appended per frame by the frame benchmarks, 1000 lines/s at 60 frames/s
+#define BENCH_WINDOW 4096000 // fixed time window of the bucket benchmarks in microseconds, the whole input at 1 line/ms
+
+// A type for the benchmarked functions, the inputs are set up in global variables
+typedef void (*Kernel)();
+
+// History depths and field counts every benchmark is run with
+int depths[] = {256, 1024, MAX_DATA_POINTS};
+int field_counts[] = {1, 4, 8};
+
+// A global variable to store the synthetic serial input, BENCH_INPUT_LINES lines as they arrive from the device
+char input[BENCH_INPUT_LINES * LINE_SIZE];
+// A global variable to store the length of the synthetic serial input
+int input_length;
+// A global variable to store the same lines one per LINE_SIZE slot, for the parser
+char input_lines[BENCH_INPUT_LINES][LINE_SIZE];
+// A global variable to store the length of each line without its newline
+int input_line_lengths[BENCH_INPUT_LINES];
+// A global variable to store the history depth of the current benchmark
+int bench_depth;
+// A global variable to store where the data points of the transform benchmark end up
+double bench_x_latest, bench_x_per_us;
+float bench_y_factor;
+// A global variable to store the value that keeps the compiler from dropping the benchmarked calls
+volatile uint32_t sink;
+// A global variable to store the recorded data set used as input, NULL for the synthetic input
+FILE *recording = NULL;
+// A global variable to store the number of points transform_points() left after decimation
+int bench_points;
+// Global variables to store the display, window and graphics context of the X submission benchmarks
+Display *display;
+Window window;
+GC gc;
+// Global variables to store the off-screen OpenGL context of -e and the framebuffer it draws into
+EGLDisplay egl_display;
+EGLContext egl_context;
+GLuint egl_framebuffer, egl_renderbuffer;
+// A global variable to store the number of malloc, calloc and realloc calls since it was last reset
+volatile uint64_t allocations = 0;
+
+// glibc's allocator, the counting wrappers below forward to it
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+
+// Counting replacements of the allocator functions, they interpose the ones of the C library for the whole program
+void *malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+    allocations++;
+    return __libc_realloc(pointer, size);
+}
+
+// A function to read the next line of the recorded data set into line, starting over at its end
+// Return the length of the line without its newline, a CR before it is kept like the device sent it
+int read_recorded_line(char *line) {
+    if (fgets(line, LINE_SIZE - 1, recording) == NULL) {
+        rewind(recording);
+        if (fgets(line, LINE_SIZE - 1, recording) == NULL) {
+            fprintf(stderr, "Error: The recorded data set is empty\n");
+            exit(1);
+        }
+    }
+    return strcspn(line, "\n");
+}
+
+// A function to format the synthetic input with the given number of fields, like serial_generator sends it,
+// or to read it from the recorded data set
+void make_input(int num_fields) {
+    input_length = 0;
+    for (int l = 0; l < BENCH_INPUT_LINES; l++) {
+        char *line = input_lines[l];
+        int length;
+        if (recording != NULL) {
+            length = read_recorded_line(line);
+        } else {
+            length = sprintf(line, "%u", 1000 + l);
+            for (int i = 0; i < num_fields; i++) {
+                length += sprintf(line + length, ",%.3f", 100.0 * sin(l * 0.01 * (i + 1)) + i * 10);
+            }
+        }
+        input_line_lengths[l] = length;
+        line[length] = '\n';
+        memcpy(input + input_length, line, length + 1);
+        input_length += length + 1;
+    }
+}
+
+// A function to empty the history, line buffer and clock model of the benchmarked device
+void reset_device(int num_fields) {
+    SerialDevice *device = &devices[0];
+    device->num_fields = num_fields;
+    device->timestamp_unit = 1000;
+    device->synchronized = 1;
+    device->truncating = 0;
+    device->line_length = 0;
+    device->buffer_start = 0;
+    device->buffer_size = 0;
+    memset(&device->clock, 0, sizeof(device->clock));
+    memset(&device->stats, 0, sizeof(device->stats));
+}
+
+// A function to fill the history of the benchmarked device with depth data points
+void fill_history(int num_fields, int depth) {
+    reset_device(num_fields);
+    for (int l = 0; l < depth; l++) {
+        ingest_line(&devices[0], input_lines[l % BENCH_INPUT_LINES], input_line_lengths[l % BENCH_INPUT_LINES], l);
+    }
+}
+
+// The line framer followed by the ingest of every complete line, fed in chunks of the size serial_cb() reads
+void kernel_frame() {
+    reset_device(devices[0].num_fields);
+    for (int offset = 0; offset < input_length; offset += SERIAL_READ_CHUNK) {
+        int n = (input_length - offset < SERIAL_READ_CHUNK) ? input_length - offset : SERIAL_READ_CHUNK;
+        // the host time advances about one millisecond per line like the device timestamps
+        frame_chunk(&devices[0], input + offset, n, (double) offset * BENCH_INPUT_LINES / input_length);
+    }
+    sink = devices[0].stats.lines;
+}
+
+// The ingest of every line alone: parser, timestamp unwrapping, clock model and history
+void kernel_ingest() {
+    reset_device(devices[0].num_fields);
+    for (int l = 0; l < BENCH_INPUT_LINES; l++) {
+        ingest_line(&devices[0], input_lines[l], input_line_lengths[l], l);
+    }
+    sink = devices[0].stats.lines;
+}
+
+// The CSV parser alone
+void kernel_parse() {
+    DataPoint data_point;
+    uint32_t counter;
+    uint32_t parsed = 0;
+    for (int l = 0; l < BENCH_INPUT_LINES; l++) {
+        parsed += parse_data_point(&devices[0], input_lines[l], input_line_lengths[l], &counter, &data_point) == PARSE_OK;
+    }
+    sink = parsed;
+}
+
+// The min/max search of update_graph() over the whole history
+void kernel_autoscale() {
+    update_graph();
+    sink = (uint32_t) devices[0].max_value;
+}
+
+// The coordinate math and decimation of draw_pane() for every field of the history
+void kernel_transform() {
+    for (int i = 0; i < devices[0].num_fields; i++) {
+        bench_points = transform_points(&devices[0], i, bench_x_latest, bench_x_per_us, BENCH_HEIGHT - MARGIN, devices[0].min_value, bench_y_factor);
+    }
+    sink = points[0].x;
+}
+
+// A function to append BENCH_FRAME_POINTS data points to the history like a device sending 1000 lines/s does between
+// two frames, the oldest ones are dropped so the history keeps the depth of the benchmark
+void append_frame_points() {
+    SerialDevice *device = &devices[0];
+    for (int k = 0; k < BENCH_FRAME_POINTS; k++) {
+        DataPoint data_point = device->buffer[RING_INDEX(device->buffer_start + k)];
+        append_data_point(device, device->max_timestamp + 1000, &data_point);
+        device->stats.lines++;
+    }
+    while (device->buffer_size > bench_depth) {
+        device->buffer_start = RING_INDEX(device->buffer_start + 1);
+        device->buffer_size--;
+        device->first_timestamp += device->buffer[device->buffer_start].delta;
+    }
+}
+
+// A frame of the Xlib render backend without the vertex cache: new data points, then every field transformed, decimated
+// and drawn with one XDrawLines request, executed by the server
+void kernel_xlib_frame() {
+    append_frame_points();
+    for (int i = 0; i < devices[0].num_fields; i++) {
+        bench_points = transform_points(&devices[0], i, bench_x_latest, bench_x_per_us, BENCH_HEIGHT - MARGIN, devices[0].min_value, bench_y_factor);
+        XDrawLines(display, window, gc, (XPoint *) points, bench_points, CoordModeOrigin);
+    }
+    XSync(display, False);
+}
+
+// A function to draw a relative polyline into the benchmark window like the Xlib render backend
+void bench_polyline_relative(void *context, int color, PlotPoint *polyline, int count) {
+    XDrawLines(display, window, gc, (XPoint *) polyline, count, CoordModePrevious);
+}
+PlotRenderer bench_xlib_renderer = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, bench_polyline_relative};
+
+// The same Xlib frame with the vertex cache: only the new data points are transformed, the retained polylines are sent as they are
+void kernel_xlib_frame_cached() {
+    append_frame_points();
+    for (int i = 0; i < devices[0].num_fields; i++) {
+        update_vertex_cache(&devices[0], i, bench_x_per_us, BENCH_HEIGHT - MARGIN, devices[0].min_value, bench_y_factor);
+        draw_cached_series(&bench_xlib_renderer, 0, &devices[0], i, bench_x_latest);
+    }
+    XSync(display, False);
+}
+
+// A frame of the OpenGL render backend: new data points streamed into the vertex buffer, then one line strip per field,
+// finished by the GL implementation
+void kernel_gl_frame() {
+    append_frame_points();
+    gl_begin_frame();
+    for (int i = 0; i < devices[0].num_fields; i++) {
+        gl_renderer.draw_series(NULL, graph.colors[i], &devices[0], i, bench_x_latest, bench_x_per_us, BENCH_HEIGHT - MARGIN, devices[0].min_value, bench_y_factor);
+    }
+    gl_finish();
+}
+
+// The same OpenGL frame with the whole history uploaded again, as without streaming
+void kernel_gl_frame_upload() {
+    gl_invalidate_series(&devices[0]);
+    kernel_gl_frame();
+}
+
+// A render backend that draws nothing, for the kernels that lay out whole frames in the core
+void null_rectangle(void *context, int color, int x, int y, int width, int height) {}
+void null_line(void *context, int color, int x1, int y1, int x2, int y2) {}
+void null_polyline(void *context, int color, PlotPoint *polyline, int count) {}
+void null_text(void *context, int color, int x, int y, const char *text) {}
+void null_image(void *context, int x, int y, int width, int height, const uint32_t *pixels) {}
+PlotRenderer null_renderer = {NULL, null_rectangle, null_rectangle, null_line, null_polyline, null_text, NULL, null_image, NULL, null_polyline};
+
+// A frame of the vertex cache: new data points, then the retained polyline of every field brought up to date and handed over
+void kernel_vertex_cache() {
+    append_frame_points();
+    for (int i = 0; i < devices[0].num_fields; i++) {
+        update_vertex_cache(&devices[0], i, bench_x_per_us, BENCH_HEIGHT - MARGIN, devices[0].min_value, bench_y_factor);
+        draw_cached_series(&null_renderer, 0, &devices[0], i, bench_x_latest);
+    }
+    sink = devices[0].vertex_caches[0].end;
+}
+
+// A frame of the XY mode: new data points, then the fade pass, their lines and the image of the raster
+void kernel_xy_frame() {
+    append_frame_points();
+    draw_xy_frame(&null_renderer);
+    sink = raster.pixels[0];
+}
+
+// The ingest path with a fixed time window, every data point is also reduced into its bucket
+void kernel_ingest_window() {
+    window_span = BENCH_WINDOW;
+    kernel_ingest();
+    window_span = 0;
+}
+
+// The coordinate math and decimation of the buckets of the fixed time window, for all data fields
+void kernel_transform_buckets() {
+    for (int i = 0; i < devices[0].num_fields; i++) {
+        bench_points = transform_buckets(&devices[0], i, BENCH_WIDTH, (double) BENCH_WIDTH / BENCH_WINDOW, BENCH_HEIGHT - MARGIN, -200, 1);
+    }
+    sink = points[0].x;
+}
+
+// The ingest path with the density mode on, every data point is also binned into the raster
+void kernel_ingest_density() {
+    density_mode = 1;
+    kernel_ingest();
+    density_mode = 0;
+}
+
+// The binning of the density mode on its own: the whole history counted into the hits of the raster, as when the plot starts over
+void kernel_bin() {
+    SerialDevice *device = &devices[0];
+    int64_t timestamp = device->first_timestamp;
+    for (int j = 0; j < device->buffer_size; j++) {
+        DataPoint *point = &device->buffer[RING_INDEX(device->buffer_start + j)];
+        if (j > 0) {
+            timestamp += point->delta;
+        }
+        bin_data_point(device, timestamp, point);
+    }
+    sink = raster.hits[0];
+}
+
+// The ingest path with the scope mode on, the trigger is checked on every data point and captures the window when it fires
+void kernel_ingest_scope() {
+    scope_mode = 1;
+    kernel_ingest();
+    scope_mode = 0;
+}
+
+// A frame of the density mode: the fade pass adding the hits and the colormap of the raster, the samples were binned by ingest_line
+void kernel_density_frame() {
+    draw_density_frame(&null_renderer);
+    sink = raster.pixels[0];
+}
+
+// X submission: one XDrawLine request per segment, as the Xlib render backend did it before XDrawLines, executed by the server
+void kernel_x_draw_line() {
+    for (int j = 1; j < bench_points; j++) {
+        XDrawLine(display, window, gc, points[j - 1].x, points[j - 1].y, points[j].x, points[j].y);
+    }
+    XSync(display, False);
+}
+
+// X submission: one XDrawLines request for the whole polyline
+void kernel_x_draw_lines() {
+    XDrawLines(display, window, gc, (XPoint *) points, bench_points, CoordModeOrigin);
+    XSync(display, False);
+}
+
+// X submission: one XDrawSegments request with every segment
+void kernel_x_draw_segments() {
+    static XSegment segments[MAX_DATA_POINTS];
+    for (int j = 1; j < bench_points; j++) {
+        segments[j - 1].x1 = points[j - 1].x;
+        segments[j - 1].y1 = points[j - 1].y;
+        segments[j - 1].x2 = points[j].x;
+        segments[j - 1].y2 = points[j].y;
+    }
+    XDrawSegments(display, window, gc, segments, bench_points - 1);
+    XSync(display, False);
+}
+
+// A function to compare two durations for qsort
+int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// A function to time a number of calls of a kernel
+// Return the nanoseconds they took
+int64_t time_kernel(Kernel kernel, int calls) {
+    int64_t start = perf_now();
+    for (int c = 0; c < calls; c++) {
+        kernel();
+    }
+    return perf_now() - start;
+}
+
+// A global variable to store the fastest repetition of the latest benchmark, in nanoseconds per call
+double bench_min_time;
+// A global variable to store the allocations of one call of the latest benchmark, after the warm up
+uint64_t bench_allocations;
+// A global variable to store the allocations of one call of each core kernel added up, they must stay 0
+uint64_t core_allocations = 0;
+
+// A function to run a kernel calibrated, warmed up and repeated
+// Return the median nanoseconds per call, the fastest repetition is kept in bench_min_time and the allocations of one
+// more call, in steady state, in bench_allocations
+double run_benchmark(Kernel kernel) {
+    // double the calls until one repetition takes a tenth of the minimum time, then scale up
+    int calls = 1;
+    int64_t elapsed;
+    while ((elapsed = time_kernel(kernel, calls)) < BENCH_MIN_TIME / 10) {
+        calls *= 2;
+    }
+    calls = (int) ((double) calls * BENCH_MIN_TIME / elapsed) + 1;
+    for (int r = 0; r < BENCH_WARMUP; r++) {
+        time_kernel(kernel, calls);
+    }
+    double times[BENCH_REPETITIONS];
+    for (int r = 0; r < BENCH_REPETITIONS; r++) {
+        times[r] = (double) time_kernel(kernel, calls) / calls;
+    }
+    qsort(times, BENCH_REPETITIONS, sizeof(double), compare_doubles);
+    bench_min_time = times[0];
+    allocations = 0;
+    kernel();
+    bench_allocations = allocations;
+    return times[BENCH_REPETITIONS / 2];
+}
+
+// A function to print one result line, bytes is 0 for the kernels that do not consume serial input
+void report(const char *kernel, int depth, int num_fields, double ns_per_call, int samples, int bytes) {
+    printf("%-24s %6d %6d %12.1f %10.2f %10.2f %8lu", kernel, depth, num_fields, ns_per_call, ns_per_call / samples, bench_min_time / samples,
+           (unsigned long) bench_allocations);
+    if (bytes > 0) {
+        printf(" %10.1f", bytes / ns_per_call * 1000.0);
+    }
+    printf("\n");
+}
+
+// A function to open a window for the X submission benchmarks, with an OpenGL context for the frame benchmarks
+void init_x11(int gl) {
+    display = XOpenDisplay(NULL);
+    if (display == NULL) {
+        fprintf(stderr, "Error: Cannot open display\n");
+        exit(1);
+    }
+    int screen = DefaultScreen(display);
+    XVisualInfo *visual = NULL;
+    if (gl) {
+        // both backends draw into the same window, it needs a visual OpenGL can draw with
+        visual = gl_choose_visual(display, screen);
+        XSetWindowAttributes attributes;
+        attributes.colormap = XCreateColormap(display, RootWindow(display, screen), visual->visual, AllocNone);
+        window = XCreateWindow(display, RootWindow(display, screen), 0, 0, BENCH_WIDTH, BENCH_HEIGHT, 1, visual->depth,
+                               InputOutput, visual->visual, CWColormap, &attributes);
+    } else {
+        window = XCreateSimpleWindow(display, RootWindow(display, screen), 0, 0, BENCH_WIDTH, BENCH_HEIGHT, 1,
+                                     BlackPixel(display, screen), WhitePixel(display, screen));
+    }
+    gc = XCreateGC(display, window, 0, NULL);
+    XMapWindow(display, window);
+    XSync(display, False);
+    if (gl) {
+        gl_init(display, window, visual);
+        XFree(visual);
+    }
+}
+
+// A function to create an OpenGL context without a display for the frame benchmarks of -e, drawing into a framebuffer
+// object the size of the benchmark window
+void init_egl() {
+    egl_display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, NULL, NULL)) {
+        fprintf(stderr, "Error: Cannot initialize a surfaceless EGL display\n");
+        exit(1);
+    }
+    eglBindAPI(EGL_OPENGL_API);
+    EGLint attributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config;
+    EGLint num_configs = 0;
+    eglChooseConfig(egl_display, attributes, &config, 1, &num_configs);
+    egl_context = eglCreateContext(egl_display, num_configs > 0 ? config : NULL, EGL_NO_CONTEXT, NULL);
+    if (egl_context == EGL_NO_CONTEXT || !eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_context)) {
+        fprintf(stderr, "Error: Cannot create an OpenGL context with EGL\n");
+        exit(1);
+    }
+    glGenFramebuffers(1, &egl_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, egl_framebuffer);
+    glGenRenderbuffers(1, &egl_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, egl_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, BENCH_WIDTH, BENCH_HEIGHT);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, egl_renderbuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Error: Cannot create an off-screen framebuffer\n");
+        exit(1);
+    }
+    gl_init_current();
+}
+
+// A function to destroy the off-screen OpenGL context of -e
+void close_egl() {
+    gl_close_current();
+    glDeleteFramebuffers(1, &egl_framebuffer);
+    glDeleteRenderbuffers(1, &egl_renderbuffer);
+    eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(egl_display, egl_context);
+    eglTerminate(egl_display);
+}
+
+// A function to close the window of the X submission benchmarks
+void close_x11(int gl) {
+    if (gl) {
+        gl_close();
+    }
+    XFreeGC(display, gc);
+    XDestroyWindow(display, window);
+    XCloseDisplay(display);
+}
+
+// A function to print the command line usage and exit
+void usage(char *program) {
+    fprintf(stderr, "Usage: %s [-c <cpu>] [-x] [-g] [-e] [-i <recorded data>]\n", program);
+    fprintf(stderr, "       -c pins the benchmark to a CPU (default the one it starts on)\n");
+    fprintf(stderr, "       -x also benchmarks the X submission strategies, needs a display (Xvfb)\n");
+    fprintf(stderr, "       -g also compares frames of the Xlib and the OpenGL render backend, needs a display with GLX (Xvfb and Mesa llvmpipe)\n");
+    fprintf(stderr, "       -e also benchmarks frames of the OpenGL render backend without a display, off-screen through EGL (not with -g)\n");
+    fprintf(stderr, "       -i uses the lines of a recorded CSV file as serial input, with its number of fields\n");
+    exit(1);
+}
+
+// The main function of the program
+int main(int argc, char **argv) {
+    int cpu = sched_getcpu();
+    int x_benchmarks = 0;
+    int gl_benchmarks = 0;
+    int egl_benchmarks = 0;
+    int option;
+    while ((option = getopt(argc, argv, "c:xgei:")) != -1) {
+        switch (option) {
+            case 'c': cpu = atoi(optarg); break;
+            case 'x': x_benchmarks = 1; break;
+            case 'g': gl_benchmarks = 1; break;
+            case 'e': egl_benchmarks = 1; break;
+            case 'i':
+                recording = fopen(optarg, "r");
+                if (recording == NULL) {
+                    fprintf(stderr, "Error: Cannot open %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            default: usage(argv[0]);
+        }
+    }
+    if (gl_benchmarks && egl_benchmarks) {
+        usage(argv[0]);
+    }
+
+    // Pin to one CPU so the runs do not migrate between cores with different clocks and caches
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) == -1) {
+        fprintf(stderr, "Warning: Cannot pin to CPU %d, the results may be noisy\n", cpu);
+        cpu = -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    num_devices = 1;
+    init_device(&devices[0], "bench", 1, 1000);
+    graph.width = BENCH_WIDTH;
+    graph.height = BENCH_HEIGHT;
+    if (x_benchmarks || gl_benchmarks) {
+        init_x11(gl_benchmarks);
+    }
+    if (egl_benchmarks) {
+        init_egl();
+    }
+
+    // the recorded data set is run with its own number of fields only
+    if (recording != NULL) {
+        char line[LINE_SIZE];
+        read_recorded_line(line);
+        rewind(recording);
+        field_counts[0] = 0;
+        for (char *c = line; *c != '\0'; c++) {
+            field_counts[0] += (*c == ',');
+        }
+        if (field_counts[0] < 1 || field_counts[0] > MAX_DATA_FIELDS) {
+            fprintf(stderr, "Error: The recorded data set must have 1 to %d data fields\n", MAX_DATA_FIELDS);
+            exit(1);
+        }
+    }
+
+    printf("CPU %d (-1 not pinned), %d lines of input, median of %d repetitions of at least %d ms\n",
+           cpu, BENCH_INPUT_LINES, BENCH_REPETITIONS, BENCH_MIN_TIME / 1000000);
+    printf("%-24s %6s %6s %12s %10s %10s %8s %10s\n", "kernel", "depth", "fields", "ns/call", "ns/sample", "min", "allocs", "MB/s");
+    int num_field_counts = (recording != NULL) ? 1 : sizeof(field_counts) / sizeof(field_counts[0]);
+    for (int f = 0; f < num_field_counts; f++) {
+        int num_fields = field_counts[f];
+        make_input(num_fields);
+        reset_device(num_fields);
+
+        // the serial input side does not depend on the history depth
+        // the cost of the framer alone is the difference of frame_chunk and ingest_line
+        report("frame_chunk", BENCH_INPUT_LINES, num_fields, run_benchmark(kernel_frame), BENCH_INPUT_LINES, input_length);
+        core_allocations += bench_allocations;
+        report("ingest_line", BENCH_INPUT_LINES, num_fields, run_benchmark(kernel_ingest), BENCH_INPUT_LINES, input_length);
+        core_allocations += bench_allocations;
+        report("parse_data_point", BENCH_INPUT_LINES, num_fields, run_benchmark(kernel_parse), BENCH_INPUT_LINES, input_length);
+        core_allocations += bench_allocations;
+        // the fixed time window reduces the input to buckets, its transform does not depend on the sample rate
+        bucket_span = BENCH_WINDOW / WINDOW_BUCKETS;
+        report("ingest_line window", BENCH_INPUT_LINES, num_fields, run_benchmark(kernel_ingest_window), BENCH_INPUT_LINES, input_length);
+        core_allocations += bench_allocations;
+        report("transform_buckets", WINDOW_BUCKETS, num_fields, run_benchmark(kernel_transform_buckets), BENCH_INPUT_LINES * num_fields, 0);
+        core_allocations += bench_allocations;
+        // the density mode lays out its raster from a full history first, its frames do not depend on the sample rate
+        fill_history(num_fields, MAX_DATA_POINTS);
+        density_mode = 1;
+        draw_density_frame(&null_renderer);
+        density_mode = 0;
+        report("ingest_line density", BENCH_INPUT_LINES, num_fields, run_benchmark(kernel_ingest_density), BENCH_INPUT_LINES, input_length);
+        core_allocations += bench_allocations;
+        report("density frame", 0, num_fields, run_benchmark(kernel_density_frame), 1, 0);
+        core_allocations += bench_allocations;
+        // a frame first, so the plot is valid again and bin_data_point counts every data point
+        density_mode = 1;
+        draw_density_frame(&null_renderer);
+        density_mode = 0;
+        report("bin_data_point", devices[0].buffer_size, num_fields, run_benchmark(kernel_bin), devices[0].buffer_size, 0);
+        core_allocations += bench_allocations;
+        // the scope mode triggers on the first field rising through 0, the input crosses it every 628 lines
+        report("ingest_line scope", BENCH_INPUT_LINES, num_fields, run_benchmark(kernel_ingest_scope), BENCH_INPUT_LINES, input_length);
+        core_allocations += bench_allocations;
+
+        for (unsigned int d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+            bench_depth = depths[d];
+            fill_history(num_fields, bench_depth);
+            update_graph();
+            SerialDevice *device = &devices[0];
+            double x_factor = (double) graph.width * 1000.0 / graph.span;
+            bench_x_latest = graph.width;
+            bench_x_per_us = device->clock.rate * x_factor / 1000.0;
+            bench_y_factor = (BENCH_HEIGHT - MARGIN) / (device->max_value - device->min_value);
+
+            report("update_graph", bench_depth, num_fields, run_benchmark(kernel_autoscale), bench_depth, 0);
+            core_allocations += bench_allocations;
+            report("transform_points", bench_depth, num_fields, run_benchmark(kernel_transform), bench_depth * num_fields, 0);
+            core_allocations += bench_allocations;
+            // the vertex cache transforms the data points of one frame, its cost should not depend on the depth
+            report("vertex cache", bench_depth, num_fields, run_benchmark(kernel_vertex_cache), BENCH_FRAME_POINTS * num_fields, 0);
+            core_allocations += bench_allocations;
+            // the XY mode plots the first two fields of the latest depth data points, its cost per frame should not depend on the depth
+            if (num_fields >= 2) {
+                xy_samples = bench_depth;
+                report("XY frame", bench_depth, 2, run_benchmark(kernel_xy_frame), BENCH_FRAME_POINTS, 0);
+                core_allocations += bench_allocations;
+            }
+            // the X submission only depends on the number of points left after decimation, it is run once per depth
+            if (x_benchmarks && f == 0) {
+                report("XDrawLine per segment", bench_depth, 1, run_benchmark(kernel_x_draw_line), bench_points, 0);
+                report("XDrawLines", bench_depth, 1, run_benchmark(kernel_x_draw_lines), bench_points, 0);
+                report("XDrawSegments", bench_depth, 1, run_benchmark(kernel_x_draw_segments), bench_points, 0);
+            }
+            // a whole frame of each backend, the history keeps its depth while new data points stream in
+            if (gl_benchmarks) {
+                report("Xlib frame", bench_depth, num_fields, run_benchmark(kernel_xlib_frame), bench_depth * num_fields, 0);
+                report("Xlib frame cached", bench_depth, num_fields, run_benchmark(kernel_xlib_frame_cached), bench_depth * num_fields, 0);
+            }
+            if (gl_benchmarks || egl_benchmarks) {
+                report("GL frame", bench_depth, num_fields, run_benchmark(kernel_gl_frame), bench_depth * num_fields, 0);
+                report("GL frame full upload", bench_depth, num_fields, run_benchmark(kernel_gl_frame_upload), bench_depth * num_fields, 0);
+            }
+        }
+    }
+
+    if (x_benchmarks || gl_benchmarks) {
+        close_x11(gl_benchmarks);
+    }
+    if (egl_benchmarks) {
+        close_egl();
+    }
+    // the X submission may allocate inside Xlib, only the core kernels are checked
+    if (core_allocations > 0) {
+        fprintf(stderr, "Error: The core kernels allocated %lu times in steady state\n", (unsigned long) core_allocations);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,2 @@
+#!/bin/bash
+gcc -O2 bench_kernels.c plotter_core.c gl_renderer.c -o bench_kernels -lX11 -lGL -lEGL -lm
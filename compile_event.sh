@@ -1,2 +1,2 @@
 #!/bin/bash
-gcc serial_plotter_resize_event.c -o event_serial_plotter -lX11 -lev
+gcc serial_plotter_resize_event.c plotter_core.c gl_renderer.c -o event_serial_plotter -lX11 -lGL -lev -lm -lpthread
@@ -0,0 +1,2 @@
+#!/bin/bash
+gcc serial_generator.c -o serial_generator -lm
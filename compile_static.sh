@@ -1,2 +1,2 @@
 #/bin/bash
-gcc -Os -static serial_plotter_resize_event.c -o event_serial_plotter_static -lX11 -lev -lxcb -lc -lXau -lXdmcp 
+gcc -Os -static -DNO_GL serial_plotter_resize_event.c plotter_core.c gl_renderer.c -o event_serial_plotter_static -lX11 -lev -lm -lpthread -lxcb -lc -lXau -lXdmcp 
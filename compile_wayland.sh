@@ -0,0 +1,6 @@
+#!/bin/bash
+# the xdg-shell glue is generated from the protocol description of wayland-protocols
+PROTOCOL=$(pkg-config --variable=pkgdatadir wayland-protocols)/stable/xdg-shell/xdg-shell.xml
+wayland-scanner client-header $PROTOCOL xdg-shell-client-protocol.h
+wayland-scanner private-code $PROTOCOL xdg-shell-protocol.c
+gcc wayland_plotter2.c plotter_core.c xdg-shell-protocol.c -o wayland_plotter -lwayland-client -lcairo -lm
@@ -0,0 +1,456 @@
+// OpenGL render backend of the plotter core, see gl_renderer.h
+// The data series are drawn from vertex buffers with a small shader, everything else (background, axes, overlays, text)
+// is a handful of fixed function primitives per frame.
+#define GL_GLEXT_PROTOTYPES
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "gl_renderer.h"
+
+#ifndef NO_GL
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <GL/glx.h>
+
+#define GL_EPOCH_SPAN (1 << 22) // microseconds the latest data point may move away from the epoch of its vertex buffer, float keeps the times to a microsecond
+#define GL_FONT "fixed" // X font the text is drawn with, like the default font of an Xlib GC
+
+// A structure to store one data point in a vertex buffer
+typedef struct {
+    float t; // Device time relative to the epoch of the buffer, in microseconds
+    float values[MAX_DATA_FIELDS]; // Data values
+} GlVertex;
+
+// A structure to store the vertex buffer mirroring the history of one device
+// The buffer holds 2 * MAX_DATA_POINTS vertices, ring slot k is stored at k and k + MAX_DATA_POINTS,
+// so the history from buffer_start on is always one contiguous range and one draw call
+// The vertices are staged from the history first, which needs the history as it is, and uploaded by the next draw,
+// which needs the context but not the history
+typedef struct {
+    GLuint buffer; // Vertex buffer, 0 before the first upload
+    int valid; // Whether the buffer holds the history of the device, once the staged vertices are uploaded
+    uint32_t lines; // stats.lines of the device at the latest staging, the data points appended since are staged next
+    int64_t epoch; // Device time the vertex times are relative to, in microseconds
+    int slot; // Ring slot of the first staged vertex
+    int staged; // Number of staged vertices not uploaded yet
+    int start; // buffer_start of the history at the latest staging, the first vertex drawn
+    int size; // buffer_size of the history at the latest staging, the number of vertices drawn
+    float t_latest; // Time of the latest data point at the latest staging, relative to the epoch
+} GlSeries;
+
+// Vertex shader placing a data point like transform_points() does, but without decimation
+const char *gl_vertex_shader =
+    "#version 110\n"
+    "attribute float t;\n"
+    "attribute float value;\n"
+    "uniform float t_latest, x_latest, x_per_us, bottom, min_value, y_factor;\n"
+    "uniform vec2 size;\n"
+    "void main() {\n"
+    "    float x = x_latest - (t_latest - t) * x_per_us;\n"
+    "    float y = bottom - (value - min_value) * y_factor;\n"
+    "    gl_Position = vec4((x + 0.5) / size.x * 2.0 - 1.0, 1.0 - (y + 0.5) / size.y * 2.0, 0.0, 1.0);\n"
+    "}\n";
+
+// Fragment shader filling the line with the color of the data field
+const char *gl_fragment_shader =
+    "#version 110\n"
+    "uniform vec3 color;\n"
+    "void main() {\n"
+    "    gl_FragColor = vec4(color, 1.0);\n"
+    "}\n";
+
+// Global variables to store the display and window the context draws into
+Display *gl_display = NULL;
+Window gl_window;
+// A global variable to store the GLX context
+GLXContext gl_context = NULL;
+// A global variable to store the shader program of the data series
+GLuint gl_program = 0;
+// Global variables to store the uniform locations of the shader program
+GLint gl_t_latest, gl_x_latest, gl_x_per_us, gl_bottom, gl_min_value, gl_y_factor, gl_size, gl_color;
+// A global variable to store the first display list of the font, one list per character
+GLuint gl_font_base = 0;
+// a global variable to store the texture holding the static layer, 0 until the first frame, and its size
+GLuint gl_static_texture = 0;
+int gl_static_width = 0, gl_static_height = 0;
+// A global variable to store the vertex buffers of the devices
+GlSeries gl_series[MAX_DEVICES];
+// A global variable to store the vertices staged for every device before they are copied into its vertex buffer
+GlVertex gl_staging[MAX_DEVICES][MAX_DATA_POINTS];
+unsigned long gl_draw_calls = 0;
+
+// A function to choose a double buffered RGBA visual, the window of the GL backend must be created with it
+XVisualInfo *gl_choose_visual(Display *display, int screen) {
+    int attributes[] = {GLX_RGBA, GLX_DOUBLEBUFFER, GLX_RED_SIZE, 8, GLX_GREEN_SIZE, 8, GLX_BLUE_SIZE, 8, None};
+    XVisualInfo *visual = glXChooseVisual(display, screen, attributes);
+    if (visual == NULL) {
+        fprintf(stderr, "Error: No double buffered RGB visual for OpenGL\n");
+        exit(1);
+    }
+    return visual;
+}
+
+// A function to compile one shader of the program
+GLuint gl_compile_shader(GLenum type, const char *source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    GLint compiled;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "Error: Cannot compile the shader: %s\n", log);
+        exit(1);
+    }
+    return shader;
+}
+
+// A function to ask for buffer swaps on the vertical blank, through whichever swap control extension GLX has
+void gl_enable_vsync() {
+    const char *extensions = glXQueryExtensionsString(gl_display, DefaultScreen(gl_display));
+    if (strstr(extensions, "GLX_EXT_swap_control") != NULL) {
+        PFNGLXSWAPINTERVALEXTPROC swap_interval = (PFNGLXSWAPINTERVALEXTPROC) glXGetProcAddress((const GLubyte *) "glXSwapIntervalEXT");
+        swap_interval(gl_display, gl_window, 1);
+    } else if (strstr(extensions, "GLX_MESA_swap_control") != NULL) {
+        PFNGLXSWAPINTERVALMESAPROC swap_interval = (PFNGLXSWAPINTERVALMESAPROC) glXGetProcAddress((const GLubyte *) "glXSwapIntervalMESA");
+        swap_interval(1);
+    } else {
+        fprintf(stderr, "Warning: GLX cannot sync the buffer swaps to the vertical blank\n");
+    }
+}
+
+// A function to create the GLX context of a window created with the visual of gl_choose_visual(), and make it current
+void gl_init(Display *display, Window window, XVisualInfo *visual) {
+    gl_display = display;
+    gl_window = window;
+    gl_context = glXCreateContext(display, visual, NULL, True);
+    if (gl_context == NULL || !glXMakeCurrent(display, window, gl_context)) {
+        fprintf(stderr, "Error: Cannot create an OpenGL context\n");
+        exit(1);
+    }
+    gl_enable_vsync();
+    gl_init_current();
+
+    // one display list per character of the X font, the text is drawn as bitmaps like XDrawString draws it
+    XFontStruct *font = XLoadQueryFont(display, GL_FONT);
+    if (font == NULL) {
+        fprintf(stderr, "Error: Cannot load the font %s\n", GL_FONT);
+        exit(1);
+    }
+    gl_font_base = glGenLists(256);
+    glXUseXFont(font->fid, 0, 256, gl_font_base);
+    XFreeFont(display, font);
+}
+
+// A function to set up the shader program and the vertex buffers of the data series in the context current on this thread
+// gl_init() calls it for its GLX context, bench_kernels -e for an off-screen context without a display (no text then)
+void gl_init_current() {
+    const char *version = (const char *) glGetString(GL_VERSION);
+    if (version == NULL || atoi(version) < 2) {
+        fprintf(stderr, "Error: OpenGL 2.0 is needed, the context has %s\n", version != NULL ? version : "none");
+        exit(1);
+    }
+    fprintf(stderr, "OpenGL: %s, %s\n", (const char *) glGetString(GL_RENDERER), version);
+
+    // the shader program of the data series, the attributes get fixed locations so no lookup is needed per draw
+    gl_program = glCreateProgram();
+    glAttachShader(gl_program, gl_compile_shader(GL_VERTEX_SHADER, gl_vertex_shader));
+    glAttachShader(gl_program, gl_compile_shader(GL_FRAGMENT_SHADER, gl_fragment_shader));
+    glBindAttribLocation(gl_program, 0, "t");
+    glBindAttribLocation(gl_program, 1, "value");
+    glLinkProgram(gl_program);
+    GLint linked;
+    glGetProgramiv(gl_program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        fprintf(stderr, "Error: Cannot link the shader program\n");
+        exit(1);
+    }
+    gl_t_latest = glGetUniformLocation(gl_program, "t_latest");
+    gl_x_latest = glGetUniformLocation(gl_program, "x_latest");
+    gl_x_per_us = glGetUniformLocation(gl_program, "x_per_us");
+    gl_bottom = glGetUniformLocation(gl_program, "bottom");
+    gl_min_value = glGetUniformLocation(gl_program, "min_value");
+    gl_y_factor = glGetUniformLocation(gl_program, "y_factor");
+    gl_size = glGetUniformLocation(gl_program, "size");
+    gl_color = glGetUniformLocation(gl_program, "color");
+    memset(gl_series, 0, sizeof(gl_series));
+}
+
+// A function to set up the viewport and pixel coordinates of a frame, from the top left corner like X11
+void gl_begin_frame() {
+    glViewport(0, 0, graph.width, graph.height);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0, graph.width, graph.height, 0, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    gl_draw_calls = 0;
+}
+
+// A function to show the frame drawn, with vsync the swap waits for the vertical blank
+void gl_swap_buffers() {
+    glXSwapBuffers(gl_display, gl_window);
+}
+
+// A function to wait until OpenGL finished drawing the frame
+void gl_finish() {
+    glFinish();
+}
+
+// A function to make the next frame upload the whole history of a device again
+void gl_invalidate_series(SerialDevice *device) {
+    gl_series[device - devices].valid = 0;
+}
+
+// A function to copy the data points of a device from history position first on into its staged vertices
+// The times are rebuilt backwards from the latest data point, the deltas of the history are exact integers
+void gl_stage(SerialDevice *device, GlSeries *series, int first) {
+    GlVertex *staging = gl_staging[device - devices];
+    int count = device->buffer_size - first;
+    int64_t timestamp = device->max_timestamp;
+    for (int j = device->buffer_size - 1; j >= first; j--) {
+        DataPoint *point = &device->buffer[RING_INDEX(device->buffer_start + j)];
+        staging[j - first].t = (float) (timestamp - series->epoch);
+        memcpy(staging[j - first].values, point->values, sizeof(point->values));
+        timestamp -= point->delta;
+    }
+    series->slot = RING_INDEX(device->buffer_start + first);
+    series->staged = count;
+}
+
+// A function to stage the data points a device appended since the previous staging, without any OpenGL call
+// The whole history is staged again if it moved on by more than it holds, away from the epoch of the buffer or past vertices
+// still waiting for their upload. Staging twice without new data points changes nothing, so every data field may ask for it
+// The front end calls it with its lock held and uploads the vertices with gl_draw_staged_series() after releasing it
+void gl_stage_series(SerialDevice *device) {
+    GlSeries *series = &gl_series[device - devices];
+    uint32_t appended = device->stats.lines - series->lines;
+    if (!series->valid || appended >= (uint32_t) device->buffer_size || device->max_timestamp - series->epoch > GL_EPOCH_SPAN ||
+        (appended > 0 && series->staged > 0)) {
+        series->epoch = device->max_timestamp;
+        gl_stage(device, series, 0);
+        series->valid = 1;
+    } else if (appended > 0) {
+        gl_stage(device, series, device->buffer_size - appended);
+    }
+    series->lines = device->stats.lines;
+    series->start = device->buffer_start;
+    series->size = device->buffer_size;
+    series->t_latest = (float) (device->max_timestamp - series->epoch);
+}
+
+// A function to copy the staged vertices of a device into its vertex buffer and bind it
+void gl_upload(int index, GlSeries *series) {
+    if (series->buffer == 0) {
+        glGenBuffers(1, &series->buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, series->buffer);
+        glBufferData(GL_ARRAY_BUFFER, 2 * MAX_DATA_POINTS * sizeof(GlVertex), NULL, GL_DYNAMIC_DRAW);
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, series->buffer);
+    }
+    if (series->staged == 0) {
+        return;
+    }
+    // the range may wrap around the end of the ring, each part is written to both of its copies
+    GlVertex *staging = gl_staging[index];
+    int count = series->staged, slot = series->slot;
+    int part = (count < MAX_DATA_POINTS - slot) ? count : MAX_DATA_POINTS - slot;
+    glBufferSubData(GL_ARRAY_BUFFER, slot * sizeof(GlVertex), part * sizeof(GlVertex), staging);
+    glBufferSubData(GL_ARRAY_BUFFER, (slot + MAX_DATA_POINTS) * sizeof(GlVertex), part * sizeof(GlVertex), staging);
+    if (count > part) {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, (count - part) * sizeof(GlVertex), staging + part);
+        glBufferSubData(GL_ARRAY_BUFFER, MAX_DATA_POINTS * sizeof(GlVertex), (count - part) * sizeof(GlVertex), staging + part);
+    }
+    series->staged = 0;
+}
+
+// A function to draw the history of one data field of a device as one line strip
+void gl_draw_series(void *context, int color, SerialDevice *device, int field, double x_latest, double x_per_us, int bottom, float min_value, float y_factor) {
+    if (device->buffer_size < 2) {
+        return;
+    }
+    gl_stage_series(device);
+    gl_draw_staged_series(color, device - devices, field, x_latest, x_per_us, bottom, min_value, y_factor);
+}
+
+// A function to draw one data field of a device from the vertices of its latest gl_stage_series(), the history is not read
+// The staged vertices are uploaded first, by the first data field drawn
+void gl_draw_staged_series(int color, int index, int field, double x_latest, double x_per_us, int bottom, float min_value, float y_factor) {
+    GlSeries *series = &gl_series[index];
+    gl_upload(index, series);
+    glUseProgram(gl_program);
+    glUniform1f(gl_t_latest, series->t_latest);
+    glUniform1f(gl_x_latest, (float) x_latest);
+    glUniform1f(gl_x_per_us, (float) x_per_us);
+    glUniform1f(gl_bottom, (float) bottom);
+    glUniform1f(gl_min_value, min_value);
+    glUniform1f(gl_y_factor, y_factor);
+    glUniform2f(gl_size, graph.width, graph.height);
+    glUniform3fv(gl_color, 1, palette_rgb[color]);
+    glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, sizeof(GlVertex), (void *) offsetof(GlVertex, t));
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(GlVertex), (void *) (offsetof(GlVertex, values) + field * sizeof(float)));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glDrawArrays(GL_LINE_STRIP, series->start, series->size);
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+    gl_draw_calls++;
+}
+
+// Fixed function primitives, the coordinates of lines are moved to the pixel centers like the cairo backend does it
+
+// A function to fill a rectangle with a palette color
+void gl_fill_rectangle(void *context, int color, int x, int y, int width, int height) {
+    glColor3fv(palette_rgb[color]);
+    glRecti(x, y, x + width, y + height);
+    gl_draw_calls++;
+}
+
+// A function to draw the outline of a rectangle with a palette color
+void gl_draw_rectangle(void *context, int color, int x, int y, int width, int height) {
+    glColor3fv(palette_rgb[color]);
+    glBegin(GL_LINE_LOOP);
+    glVertex2f(x + 0.5f, y + 0.5f);
+    glVertex2f(x + width + 0.5f, y + 0.5f);
+    glVertex2f(x + width + 0.5f, y + height + 0.5f);
+    glVertex2f(x + 0.5f, y + height + 0.5f);
+    glEnd();
+    gl_draw_calls++;
+}
+
+// A function to draw a line with a palette color
+void gl_draw_line(void *context, int color, int x1, int y1, int x2, int y2) {
+    glColor3fv(palette_rgb[color]);
+    glBegin(GL_LINES);
+    glVertex2f(x1 + 0.5f, y1 + 0.5f);
+    glVertex2f(x2 + 0.5f, y2 + 0.5f);
+    glEnd();
+    gl_draw_calls++;
+}
+
+// A function to draw the lines between consecutive points with a palette color
+void gl_draw_polyline(void *context, int color, PlotPoint *polyline, int count) {
+    glColor3fv(palette_rgb[color]);
+    glBegin(GL_LINE_STRIP);
+    for (int j = 0; j < count; j++) {
+        glVertex2f(polyline[j].x + 0.5f, polyline[j].y + 0.5f);
+    }
+    glEnd();
+    gl_draw_calls++;
+}
+
+// A function to draw a string with a palette color, y is its baseline
+void gl_draw_text(void *context, int color, int x, int y, const char *text) {
+    // the raster color is latched by glRasterPos, so the color is set first
+    glColor3fv(palette_rgb[color]);
+    glRasterPos2i(x, y);
+    glListBase(gl_font_base);
+    glCallLists(strlen(text), GL_UNSIGNED_BYTE, text);
+    gl_draw_calls++;
+}
+
+// A function to copy an XRGB8888 image into the window, drawn downwards from its top left corner
+void gl_draw_image(void *context, int x, int y, int width, int height, const uint32_t *pixels) {
+    glRasterPos2i(x, y);
+    glPixelZoom(1.0f, -1.0f);
+    glDrawPixels(width, height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, pixels);
+    glPixelZoom(1.0f, 1.0f);
+    gl_draw_calls++;
+}
+
+PlotRenderer gl_renderer;
+
+// A function to show the static layer as one textured quad, when it changed it is drawn into the back buffer first and
+// copied into the texture from there
+void gl_static_layer(void *context, int rebuild, void (*draw)(PlotRenderer *renderer)) {
+    if (gl_static_texture == 0 || gl_static_width != graph.width || gl_static_height != graph.height) {
+        if (gl_static_texture == 0) {
+            glGenTextures(1, &gl_static_texture);
+        }
+        glBindTexture(GL_TEXTURE_2D, gl_static_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, graph.width, graph.height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        gl_static_width = graph.width;
+        gl_static_height = graph.height;
+        rebuild = 1;
+    }
+    glBindTexture(GL_TEXTURE_2D, gl_static_texture);
+    if (rebuild) {
+        draw(&gl_renderer);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, graph.width, graph.height);
+    } else {
+        // the rows of the window run down, those of the texture up from the bottom of the back buffer
+        glEnable(GL_TEXTURE_2D);
+        glColor3f(1, 1, 1);
+        glBegin(GL_QUADS);
+        glTexCoord2f(0, 1);
+        glVertex2i(0, 0);
+        glTexCoord2f(1, 1);
+        glVertex2i(graph.width, 0);
+        glTexCoord2f(1, 0);
+        glVertex2i(graph.width, graph.height);
+        glTexCoord2f(0, 0);
+        glVertex2i(0, graph.height);
+        glEnd();
+        glDisable(GL_TEXTURE_2D);
+        gl_draw_calls++;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+PlotRenderer gl_renderer = {NULL, gl_fill_rectangle, gl_draw_rectangle, gl_draw_line, gl_draw_polyline, gl_draw_text, gl_draw_series, gl_draw_image, gl_static_layer, NULL};
+
+// A function to free the vertex buffers, shaders and font and destroy the context, before the window is destroyed
+void gl_close() {
+    gl_close_current();
+    glXMakeCurrent(gl_display, None, NULL);
+    glXDestroyContext(gl_display, gl_context);
+}
+
+// A function to free the vertex buffers, shaders, font and static layer of the context current on this thread
+void gl_close_current() {
+    for (int d = 0; d < MAX_DEVICES; d++) {
+        if (gl_series[d].buffer != 0) {
+            glDeleteBuffers(1, &gl_series[d].buffer);
+        }
+    }
+    if (gl_font_base != 0) {
+        glDeleteLists(gl_font_base, 256);
+    }
+    if (gl_static_texture != 0) {
+        glDeleteTextures(1, &gl_static_texture);
+    }
+    glDeleteProgram(gl_program);
+}
+
+#else // NO_GL
+
+PlotRenderer gl_renderer;
+unsigned long gl_draw_calls = 0;
+
+// A function to report that the backend is missing, it is the first function of the backend a front end calls
+XVisualInfo *gl_choose_visual(Display *display, int screen) {
+    fprintf(stderr, "Error: Built without OpenGL (NO_GL)\n");
+    exit(1);
+}
+
+void gl_init(Display *display, Window window, XVisualInfo *visual) {}
+void gl_init_current() {
+    fprintf(stderr, "Error: Built without OpenGL (NO_GL)\n");
+    exit(1);
+}
+void gl_begin_frame() {}
+void gl_swap_buffers() {}
+void gl_finish() {}
+void gl_invalidate_series(SerialDevice *device) {}
+void gl_stage_series(SerialDevice *device) {}
+void gl_draw_staged_series(int color, int index, int field, double x_latest, double x_per_us, int bottom, float min_value, float y_factor) {}
+void gl_close() {}
+void gl_close_current() {}
+
+#endif // NO_GL
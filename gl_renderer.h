@@ -0,0 +1,31 @@
+// OpenGL render backend of the plotter core for the Xlib front ends, drawing through GLX into a double buffered window.
+// The history of every device is mirrored into a vertex buffer and only the data points appended since the previous frame
+// are uploaded. They are staged from the history first (gl_stage_series()), so a front end with a render thread copies them
+// under its lock and uploads and draws them without it.
+// A vertex shader places them with the time span and value range of the frame, so autoscaling uploads nothing.
+// Each data field is one line strip, one draw call. The buffer swaps are tied to the vertical blank when GLX supports it.
+// It needs OpenGL 2.0, Mesa llvmpipe is enough (LIBGL_ALWAYS_SOFTWARE=1 on a machine without a GPU).
+// Built with -DNO_GL (static builds, libGL cannot be linked statically) the backend only reports that it is missing.
+#ifndef GL_RENDERER_H
+#define GL_RENDERER_H
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include "plotter_core.h"
+
+extern PlotRenderer gl_renderer; // The OpenGL render backend, usable once gl_init() made its context current
+extern unsigned long gl_draw_calls; // Draw calls since the latest gl_begin_frame()
+
+XVisualInfo *gl_choose_visual(Display *display, int screen);
+void gl_init(Display *display, Window window, XVisualInfo *visual);
+void gl_init_current();
+void gl_begin_frame();
+void gl_swap_buffers();
+void gl_finish();
+void gl_invalidate_series(SerialDevice *device);
+void gl_stage_series(SerialDevice *device);
+void gl_draw_staged_series(int color, int index, int field, double x_latest, double x_per_us, int bottom, float min_value, float y_factor);
+void gl_close();
+void gl_close_current();
+
+#endif // GL_RENDERER_H
@@ -0,0 +1,2139 @@
+// The plotter core shared by the front ends, see plotter_core.h
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <termios.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/serial.h>
+#include "plotter_core.h"
+
+// A structure matching the kernel struct termios2 used by TCGETS2/TCSETS2 to set arbitrary baud rates
+// <asm/termbits.h> defines it too but cannot be included together with <termios.h>
+struct termios2 {
+    tcflag_t c_iflag; // input mode flags
+    tcflag_t c_oflag; // output mode flags
+    tcflag_t c_cflag; // control mode flags
+    tcflag_t c_lflag; // local mode flags
+    cc_t c_line; // line discipline
+    cc_t c_cc[19]; // control characters, the kernel NCCS is 19
+    speed_t c_ispeed; // input speed in bauds
+    speed_t c_ospeed; // output speed in bauds
+};
+#ifndef BOTHER
+#define BOTHER 0010000 // c_cflag speed value selecting the baud rate in c_ispeed/c_ospeed
+#endif
+#ifndef IBSHIFT
+#define IBSHIFT 16 // shift of the input speed bits in c_cflag
+#endif
+
+const char *perf_stage_names[PERF_STAGES] = {"parse/chunk", "autoscale", "transform", "draw", "frame interval", "locked"};
+const char *trace_names[TRACE_NAMES] = {"read", "parse", "append", "autoscale", "render", "X flush"};
+const char *parse_result_names[PARSE_RESULTS] = {"parsed", "empty line", "bad timestamp", "bad value", "wrong field count"};
+// black, red, green, blue, yellow, magenta, cyan, Gray41 and white, the X11 colors of the same names
+const float palette_rgb[COLORS][3] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {1, 1, 0}, {1, 0, 1}, {0, 1, 1}, {0.41, 0.41, 0.41}, {1, 1, 1}};
+
+struct timespec start_time;
+SerialDevice devices[MAX_DEVICES];
+int num_devices = 0;
+Graph graph;
+uint8_t color_theme = 0;
+int merged_view = 0;
+int show_stats = 0;
+int show_perf = 0;
+int baud_rate = BAUD_RATE;
+int low_latency = 0;
+int tracing = 0;
+PerfStage perf_stages[PERF_STAGES];
+int64_t perf_transform_time = 0;
+unsigned long perf_requests = 0;
+float perf_samples_per_frame = 0;
+PlotPoint points[PLOT_POINTS];
+double autoscale_hysteresis = AUTOSCALE_HYSTERESIS;
+int64_t window_span = 0;
+int64_t bucket_span = 1;
+int xy_mode = 0;
+int xy_fields[2] = {0, 1};
+int xy_samples = XY_SAMPLES;
+Raster raster;
+RasterLine raster_lines[MAX_DEVICES * MAX_DATA_POINTS];
+int defer_raster = 0;
+// a global variable to store the XY plot of every device
+XYPlot xy_plots[MAX_DEVICES];
+int density_mode = 0;
+int64_t density_sweep = DENSITY_SWEEP;
+// a global variable to store the density plot of every device
+DensityPlot density_plots[MAX_DEVICES];
+int scope_mode = 0;
+ScopeTrigger scope_trigger = {0, 0, 1, SCOPE_WINDOW, SCOPE_WINDOW * SCOPE_PRE_TRIGGER / 100, 0};
+ScopeState scope_states[MAX_DEVICES];
+// a global variable to store whether the static layer of the backend was drawn for the time plot, the other modes draw over it
+int static_layer_valid = 0;
+// a global variable to store the total number of captures drawn by the latest frame of the scope mode
+uint32_t scope_drawn = 0;
+void (*data_point_hook)(SerialDevice *device, uint32_t counter, double host_time) = NULL;
+
+// A function to return the CLOCK_MONOTONIC_RAW time in nanoseconds, used by the performance probes
+int64_t perf_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// A function to return the CLOCK_MONOTONIC time in milliseconds since the program started
+double host_time_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start_time.tv_sec) * 1000.0 + (now.tv_nsec - start_time.tv_nsec) / 1000000.0;
+}
+
+// A function to record one duration of a stage for the performance overlay
+void perf_record(int stage, int64_t duration) {
+    PerfStage *perf = &perf_stages[stage];
+    perf->samples[perf->count % PERF_SAMPLES] = (duration > UINT32_MAX) ? UINT32_MAX : (uint32_t) duration;
+    perf->count++;
+}
+
+// A function to compare two durations for qsort
+int compare_durations(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+// A function to compute the p50 and p99 of the latest durations of a stage, in microseconds
+// Return 0 if nothing was recorded yet
+int perf_percentiles(PerfStage *perf, double *p50, double *p99) {
+    uint32_t sorted[PERF_SAMPLES];
+    int n = (perf->count < PERF_SAMPLES) ? perf->count : PERF_SAMPLES;
+    if (n == 0) {
+        return 0;
+    }
+    memcpy(sorted, perf->samples, n * sizeof(uint32_t));
+    qsort(sorted, n, sizeof(uint32_t), compare_durations);
+    *p50 = sorted[n / 2] / 1000.0;
+    *p99 = sorted[n * 99 / 100] / 1000.0;
+    return 1;
+}
+
+// A function to print the p50/p99 of every stage, in the format the benchmark script reads
+void print_perf_stats(FILE *file) {
+    for (int s = 0; s < PERF_STAGES; s++) {
+        double p50, p99;
+        if (perf_percentiles(&perf_stages[s], &p50, &p99)) {
+            fprintf(file, "perf %s: p50 %.1f us, p99 %.1f us\n", perf_stage_names[s], p50, p99);
+        }
+    }
+}
+
+// A function to allocate a trace ring, the pages are touched so the capture never faults them in
+void init_trace_ring(TraceRing *ring, int tid) {
+    ring->events = malloc(TRACE_EVENTS * sizeof(TraceEvent));
+    if (ring->events == NULL) {
+        fprintf(stderr, "Error: Cannot allocate the trace ring\n");
+        exit(1);
+    }
+    memset(ring->events, 0, TRACE_EVENTS * sizeof(TraceEvent));
+    ring->next = 0;
+    ring->tid = tid;
+}
+
+// A function to begin a traced event
+// Return its begin time, 0 if tracing is off
+int64_t trace_begin() {
+    return tracing ? perf_now() : 0;
+}
+
+// A function to end a traced event begun with trace_begin() and record it into a ring
+void trace_end(TraceRing *ring, int name, int64_t begin) {
+    if (!tracing) {
+        return;
+    }
+    TraceEvent *event = &ring->events[ring->next & (TRACE_EVENTS - 1)];
+    event->begin = begin;
+    event->duration = perf_now() - begin;
+    event->name = name;
+    ring->next++;
+}
+
+// A function to write the events of a ring as Chrome trace complete events, timestamps in microseconds since origin
+// Return the number of events written
+int write_trace_ring(FILE *file, TraceRing *ring, int64_t origin, int first) {
+    uint32_t count = (ring->next < TRACE_EVENTS) ? ring->next : TRACE_EVENTS;
+    for (uint32_t i = ring->next - count; i != ring->next; i++) {
+        TraceEvent *event = &ring->events[i & (TRACE_EVENTS - 1)];
+        fprintf(file, "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %d}",
+                first ? "" : ",", trace_names[event->name], (event->begin - origin) / 1000.0, event->duration / 1000.0, ring->tid);
+        first = 0;
+    }
+    return count;
+}
+
+// A function to map a device timestamp to the host time it was received at according to the clock model
+double clock_model_host(ClockModel *model, double device_time) {
+    return model->origin_host + model->offset + model->rate * (device_time - model->origin_device);
+}
+
+// A function to map a host time to the device timestamp according to the clock model
+double clock_model_device(ClockModel *model, double host_time) {
+    return model->origin_device + (host_time - model->origin_host - model->offset) / model->rate;
+}
+
+// A function to return the estimated drift of the device clock against the host clock in parts per million
+double clock_model_drift_ppm(ClockModel *model) {
+    return (model->rate - 1.0) * 1e6;
+}
+
+// A function to return the standard deviation of the receive time around the clock model in milliseconds
+double clock_model_jitter(ClockModel *model) {
+    return sqrt(model->jitter_var);
+}
+
+// A function to feed one device timestamp and its host receive time into the clock model
+void update_clock_model(ClockModel *model, double device_time, double host_time) {
+    if (model->samples == 0) {
+        model->origin_device = device_time;
+        model->origin_host = host_time;
+        model->rate = 1.0;
+    } else {
+        // the residual against the current estimate is the receive jitter
+        double residual = host_time - clock_model_host(model, device_time);
+        double delta = residual - model->jitter_mean;
+        model->jitter_mean += (1.0 - CLOCK_MODEL_FORGETTING) * delta;
+        model->jitter_var = CLOCK_MODEL_FORGETTING * (model->jitter_var + (1.0 - CLOCK_MODEL_FORGETTING) * delta * delta);
+        // move the origin of the sums to the new sample
+        double cx = device_time - model->origin_device;
+        double cy = host_time - model->origin_host;
+        model->sxy += cx * cy * model->sw - cx * model->sy - cy * model->sx;
+        model->sxx += cx * cx * model->sw - 2 * cx * model->sx;
+        model->sx -= cx * model->sw;
+        model->sy -= cy * model->sw;
+        model->origin_device = device_time;
+        model->origin_host = host_time;
+    }
+    // age the older samples and add the new one, which sits at the origin
+    model->sw = model->sw * CLOCK_MODEL_FORGETTING + 1.0;
+    model->sx *= CLOCK_MODEL_FORGETTING;
+    model->sy *= CLOCK_MODEL_FORGETTING;
+    model->sxx *= CLOCK_MODEL_FORGETTING;
+    model->sxy *= CLOCK_MODEL_FORGETTING;
+    model->samples++;
+
+    double determinant = model->sw * model->sxx - model->sx * model->sx;
+    if (model->samples >= CLOCK_MODEL_MIN_SAMPLES && determinant > 1e-9 * model->sw * model->sxx) {
+        model->rate = (model->sw * model->sxy - model->sx * model->sy) / determinant;
+        model->offset = (model->sy - model->rate * model->sx) / model->sw;
+    } else {
+        // not enough spread in the device timestamps yet, assume both clocks run at the same rate
+        model->rate = 1.0;
+        model->offset = (model->sy - model->sx) / model->sw;
+    }
+}
+
+// A function to return the termios speed constant of a standard baud rate, or B0 if the rate is not a standard one
+speed_t standard_speed(int baud) {
+    static const struct { int baud; speed_t speed; } speeds[] = {
+        {9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600}, {115200, B115200},
+        {230400, B230400}, {460800, B460800}, {500000, B500000}, {576000, B576000}, {921600, B921600},
+        {1000000, B1000000}, {1152000, B1152000}, {1500000, B1500000}, {2000000, B2000000},
+        {2500000, B2500000}, {3000000, B3000000}, {3500000, B3500000}, {4000000, B4000000},
+    };
+    for (unsigned int i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+        if (speeds[i].baud == baud) {
+            return speeds[i].speed;
+        }
+    }
+    return B0;
+}
+
+// A function to set a baud rate that has no termios speed constant with TCSETS2 and BOTHER
+void set_custom_baud_rate(SerialDevice *device, int baud) {
+    struct termios2 options2;
+    if (ioctl(device->fd, TCGETS2, &options2) == -1) {
+        fprintf(stderr, "Error: Cannot set baud rate %d on %s\n", baud, device->name);
+        exit(1);
+    }
+    options2.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    options2.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    options2.c_ispeed = baud;
+    options2.c_ospeed = baud;
+    if (ioctl(device->fd, TCSETS2, &options2) == -1) {
+        fprintf(stderr, "Error: Cannot set baud rate %d on %s\n", baud, device->name);
+        exit(1);
+    }
+    // the driver may round the rate to what its divisor can do, report what it chose
+    if (ioctl(device->fd, TCGETS2, &options2) == 0 && options2.c_ispeed != (speed_t) baud) {
+        fprintf(stderr, "Warning: %s runs at %u baud instead of %d\n", device->name, options2.c_ispeed, baud);
+    }
+}
+
+// A function to switch the driver of a serial port to its low latency mode
+// For USB adapters like the FTDI ones this shortens the latency timer which otherwise holds received bytes back for up to 16 ms
+void set_low_latency(SerialDevice *device) {
+    struct serial_struct serial;
+    if (ioctl(device->fd, TIOCGSERIAL, &serial) == -1) {
+        fprintf(stderr, "Warning: %s does not support the low latency mode\n", device->name);
+        return;
+    }
+    serial.flags |= ASYNC_LOW_LATENCY;
+    if (ioctl(device->fd, TIOCSSERIAL, &serial) == -1) {
+        fprintf(stderr, "Warning: Cannot set the low latency mode of %s\n", device->name);
+    }
+}
+
+// A function to open a terminal device in non-blocking mode
+void open_terminal(SerialDevice *device, const char *address) {
+    device->fd = open(address, O_RDONLY | O_NOCTTY | O_NDELAY);
+    if (device->fd == -1) {
+        fprintf(stderr, "Error: Cannot open serial port %s\n", device->name);
+        exit(1);
+    }
+}
+
+// Source backend of a serial port: set up with the baud rate and read raw
+void open_tty(SerialDevice *device, const char *address) {
+    open_terminal(device, address);
+
+    // Get the current terminal attributes of the serial port
+    struct termios options;
+    tcgetattr(device->fd, &options);
+
+    // Set the input and output baud rate to the given value, non-standard rates are set below with termios2
+    speed_t speed = standard_speed(baud_rate);
+    if (speed != B0) {
+        cfsetispeed(&options, speed);
+        cfsetospeed(&options, speed);
+    }
+
+    options.c_cflag |= (CLOCAL | CREAD); // enable local mode and receiver
+    options.c_cflag &= ~PARENB; // disable parity
+    options.c_cflag &= ~CSTOPB; // disable two stop bits
+    options.c_cflag &= ~CSIZE; // mask character size bits
+    options.c_cflag |= CS8; // set 8 data bits
+    options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG); // set raw input mode
+    options.c_cflag &= ~CRTSCTS; // disable hardware flow control
+    options.c_lflag &= ~IEXTEN; // disable extended input processing
+    options.c_iflag &= ~(IXON | IXOFF | IXANY); // disable software flow control
+    options.c_iflag &= ~(ICRNL | INLCR | IGNCR | ISTRIP | BRKINT | PARMRK); // pass the received bytes unchanged
+    options.c_oflag &= ~OPOST; // disable output processing
+    // The descriptor is non-blocking and read in whole chunks when the event loop reports it readable.
+    // VMIN 1 with VTIME 0 makes poll report it as soon as one byte arrived; a larger VMIN would batch
+    // wakeups but poll would then never report the tail of a burst shorter than VMIN.
+    options.c_cc[VMIN] = 1;
+    options.c_cc[VTIME] = 0;
+
+    // Set the terminal attributes of the serial port
+    tcsetattr(device->fd, TCSANOW, &options);
+    if (speed == B0) {
+        set_custom_baud_rate(device, baud_rate);
+    }
+    if (low_latency) {
+        set_low_latency(device);
+    }
+
+    // Remember the driver error counters, only the errors since the start are reported
+    device->stats.icount_supported = (ioctl(device->fd, TIOCGICOUNT, &device->stats.icount_base) == 0);
+    device->stats.icount = device->stats.icount_base;
+}
+
+// Source backend of a pseudo terminal (serial_generator): read raw, it has no baud rate or driver counters
+void open_pty(SerialDevice *device, const char *address) {
+    open_terminal(device, address);
+    struct termios options;
+    if (tcgetattr(device->fd, &options) == 0) {
+        cfmakeraw(&options);
+        options.c_cc[VMIN] = 1;
+        options.c_cc[VTIME] = 0;
+        tcsetattr(device->fd, TCSANOW, &options);
+    }
+}
+
+// Source backend of a recorded data set, read as fast as the event loop takes it
+// The data points are placed on the host timeline by their device timestamps, see ingest_line()
+void open_replay(SerialDevice *device, const char *address) {
+    device->fd = open(address, O_RDONLY | O_NONBLOCK);
+    if (device->fd == -1) {
+        fprintf(stderr, "Error: Cannot open recorded data %s\n", address);
+        exit(1);
+    }
+    // a recording starts with a complete line, nothing is dropped to synchronize
+    device->synchronized = 1;
+}
+
+// A function to connect a stream socket and make it non-blocking, the connection itself is made blocking at startup
+void connect_socket(SerialDevice *device, int domain, struct sockaddr *address, socklen_t length) {
+    device->fd = socket(domain, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (device->fd == -1 || connect(device->fd, address, length) == -1) {
+        fprintf(stderr, "Error: Cannot connect to %s: %s\n", device->name, strerror(errno));
+        exit(1);
+    }
+    fcntl(device->fd, F_SETFL, fcntl(device->fd, F_GETFL) | O_NONBLOCK);
+}
+
+// Source backend of a TCP connection, the address is <host>:<port> (e.g. a serial to network bridge like ser2net)
+void open_tcp(SerialDevice *device, const char *address) {
+    char host[256];
+    const char *port = strrchr(address, ':');
+    if (port == NULL || port - address >= (int) sizeof(host)) {
+        fprintf(stderr, "Error: %s is not tcp:<host>:<port>\n", device->name);
+        exit(1);
+    }
+    memcpy(host, address, port - address);
+    host[port - address] = '\0';
+    struct addrinfo hints = {0};
+    struct addrinfo *result;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port + 1, &hints, &result) != 0) {
+        fprintf(stderr, "Error: Cannot resolve %s\n", device->name);
+        exit(1);
+    }
+    connect_socket(device, result->ai_family, result->ai_addr, result->ai_addrlen);
+    freeaddrinfo(result);
+}
+
+// Source backend of a unix stream socket
+void open_unix(SerialDevice *device, const char *address) {
+    struct sockaddr_un unix_address = {0};
+    if (strlen(address) >= sizeof(unix_address.sun_path)) {
+        fprintf(stderr, "Error: Socket path of %s is too long\n", device->name);
+        exit(1);
+    }
+    unix_address.sun_family = AF_UNIX;
+    strcpy(unix_address.sun_path, address);
+    connect_socket(device, AF_UNIX, (struct sockaddr *) &unix_address, sizeof(unix_address));
+}
+
+// The source backends, the pseudo terminal comes first and the serial port, which matches every name, last
+const SourceBackend source_backends[] = {
+    {"pty:", "pty", open_pty, 0},
+    {"replay:", "replay", open_replay, 1},
+    {"tcp:", "tcp", open_tcp, 0},
+    {"unix:", "unix socket", open_unix, 0},
+    {"", "tty", open_tty, 0},
+};
+
+// A function to initialize a device with its name and format, before its source is opened
+void init_device(SerialDevice *device, char *name, int num_fields, uint16_t timestamp_unit) {
+    memset(device, 0, sizeof(*device));
+    device->name = name;
+    device->num_fields = num_fields;
+    device->timestamp_unit = timestamp_unit;
+    device->stats.last_log = -LOG_INTERVAL;
+    device->fd = -1;
+    device->shrink_since = -1;
+}
+
+// A function to initialize a device from its command line arguments, the name and the number of data fields
+// The timestamps are in milliseconds unless the number of data fields ends with :us
+void parse_device(SerialDevice *device, char *name, char *format) {
+    int num_fields = atoi(format);
+    // Check if the number of data fields is valid
+    if (num_fields < 1 || num_fields > MAX_DATA_FIELDS) {
+        fprintf(stderr, "Error: Number of data fields must be between 1 and %d\n", MAX_DATA_FIELDS);
+        exit(1);
+    }
+    char *unit = strchr(format, ':');
+    uint16_t timestamp_unit = 1000;
+    if (unit != NULL && strcmp(unit, ":us") == 0) {
+        timestamp_unit = 1;
+    } else if (unit != NULL && strcmp(unit, ":ms") != 0) {
+        fprintf(stderr, "Error: Unknown timestamp unit %s, use :ms or :us\n", unit);
+        exit(1);
+    }
+    init_device(device, name, num_fields, timestamp_unit);
+}
+
+// A function to open the source of a device with the backend selected by the prefix of its name
+// A serial port name that resolves into /dev/pts/ is a pseudo terminal, it is opened without the serial port settings
+void open_source(SerialDevice *device) {
+    const SourceBackend *backend = source_backends;
+    while (strncmp(device->name, backend->prefix, strlen(backend->prefix)) != 0) {
+        backend++;
+    }
+    const char *address = device->name + strlen(backend->prefix);
+    char path[PATH_MAX];
+    if (backend->open == open_tty && realpath(address, path) != NULL && strncmp(path, "/dev/pts/", 9) == 0) {
+        backend = &source_backends[0];
+    }
+    device->backend = backend;
+    backend->open(device, address);
+}
+
+// A function to close the source of a device
+void close_source(SerialDevice *device) {
+    if (device->fd != -1) {
+        close(device->fd);
+        device->fd = -1;
+    }
+}
+
+// A function to skip the blanks after a number and check that the field ends there
+// Return a pointer to the comma or the terminating null character, NULL if something else follows the number
+char *end_of_field(char *end) {
+    while (*end == ' ' || *end == '\t') {
+        end++;
+    }
+    return (*end == ',' || *end == '\0') ? end : NULL;
+}
+
+// A function to parse a complete line received from a device as a raw timestamp counter and data values
+// The line is left intact so it can be logged when it is rejected
+// Return PARSE_OK if successful, otherwise the reason the line is not a valid data point
+int parse_data_point(SerialDevice *device, char *line, int index, uint32_t *counter, DataPoint *data_point) {
+    // Check if the line buffer has a trailing CR character and remove it
+     if (index > 0 && line [index - 1] == '\r') {
+         index--;
+     }
+    // Check if the line buffer is empty
+     if (index == 0 ) {
+         return REJECT_EMPTY;
+     }
+    // Terminate the buffer with a null character
+    line[index] = '\0';
+    // The first field should be the timestamp counter, only its low 32 bits are used so 64 bit counters work too
+    char *end;
+    *counter = (uint32_t) strtoull(line, &end, 10);
+    if (end == line || (end = end_of_field(end)) == NULL) {
+        return REJECT_TIMESTAMP;
+    }
+
+    // The following fields should be the data values
+    int i = 0;
+    while (*end == ',') {
+        char *field = end + 1;
+        if (i == device->num_fields) {
+            return REJECT_FIELD_COUNT;
+        }
+        // Convert the field to a float value and store it in the data point
+        data_point->values[i++] = strtof(field, &end);
+        if (end == field || (end = end_of_field(end)) == NULL) {
+            return REJECT_VALUE;
+        }
+        // strtof() also accepts "nan", "inf" and "infinity" and overflows to inf, such a value has no place on any axis
+        if (!isfinite(data_point->values[i - 1])) {
+            return REJECT_VALUE;
+        }
+    }
+
+    // The number of fields should match the number of data fields
+    if (i != device->num_fields) {
+        return REJECT_FIELD_COUNT;
+    }
+
+    // Return success
+    return PARSE_OK;
+}
+
+// A function to log an ingest error of a device
+// At most one message per LOG_INTERVAL is printed, the suppressed ones are counted and reported with the next message
+void log_ingest_error(SerialDevice *device, double host_time, const char *reason, const char *line) {
+    if (host_time - device->stats.last_log < LOG_INTERVAL) {
+        device->stats.suppressed++;
+        return;
+    }
+    fprintf(stderr, "Error: %s on %s", reason, device->name);
+    if (line != NULL) {
+        fprintf(stderr, ": \"%.40s\"", line);
+    }
+    if (device->stats.suppressed > 0) {
+        fprintf(stderr, " (%u more errors suppressed)", device->stats.suppressed);
+    }
+    fprintf(stderr, "\n");
+    device->stats.suppressed = 0;
+    device->stats.last_log = host_time;
+}
+
+// A function to read the driver error counters of a device and log new UART errors
+void read_driver_counters(SerialDevice *device, double host_time) {
+    IngestStats *stats = &device->stats;
+    struct serial_icounter_struct icount;
+    if (!stats->icount_supported || device->fd == -1 || ioctl(device->fd, TIOCGICOUNT, &icount) != 0) {
+        return;
+    }
+    int errors = (icount.overrun - stats->icount.overrun) + (icount.buf_overrun - stats->icount.buf_overrun) +
+                 (icount.frame - stats->icount.frame) + (icount.parity - stats->icount.parity);
+    stats->icount = icount;
+    if (errors > 0) {
+        char reason[64];
+        snprintf(reason, sizeof(reason), "%d new UART overrun/framing/parity errors", errors);
+        log_ingest_error(device, host_time, reason, NULL);
+    }
+}
+
+// A function to return the number of lines of a device lost to parse errors and truncation
+uint32_t rejected_lines(IngestStats *stats) {
+    uint32_t rejected = stats->truncated;
+    for (int r = PARSE_OK + 1; r < PARSE_RESULTS; r++) {
+        rejected += stats->rejected[r];
+    }
+    return rejected;
+}
+
+// A function to format the ingest statistics of a device as three lines of text
+void format_ingest_stats(SerialDevice *device, char text[3][160]) {
+    IngestStats *stats = &device->stats;
+    snprintf(text[0], 160, "%s: %llu bytes, %u lines, %u bytes discarded, %u timestamp resets",
+             device->name, (unsigned long long) stats->bytes, stats->lines, stats->discarded, stats->counter_resets);
+    snprintf(text[1], 160, "  rejected: %u %s, %u %s, %u %s, %u %s, %u truncated at %d bytes",
+             stats->rejected[REJECT_EMPTY], parse_result_names[REJECT_EMPTY],
+             stats->rejected[REJECT_TIMESTAMP], parse_result_names[REJECT_TIMESTAMP],
+             stats->rejected[REJECT_VALUE], parse_result_names[REJECT_VALUE],
+             stats->rejected[REJECT_FIELD_COUNT], parse_result_names[REJECT_FIELD_COUNT],
+             stats->truncated, LINE_SIZE);
+    if (stats->icount_supported) {
+        snprintf(text[2], 160, "  driver: %d received, %d overrun, %d buffer overrun, %d framing, %d parity, %d break",
+                 stats->icount.rx - stats->icount_base.rx, stats->icount.overrun - stats->icount_base.overrun,
+                 stats->icount.buf_overrun - stats->icount_base.buf_overrun, stats->icount.frame - stats->icount_base.frame,
+                 stats->icount.parity - stats->icount_base.parity, stats->icount.brk - stats->icount_base.brk);
+    } else {
+        snprintf(text[2], 160, "  driver: counters not supported by this %s", device->backend != NULL ? device->backend->name : "device");
+    }
+}
+
+// A function to print the ingest statistics of all devices
+void print_ingest_stats(FILE *file) {
+    char text[3][160];
+    for (int d = 0; d < num_devices; d++) {
+        format_ingest_stats(&devices[d], text);
+        fprintf(file, "%s\n%s\n%s\n", text[0], text[1], text[2]);
+    }
+}
+
+// A function to unwrap a raw device timestamp counter into the 64 bit microsecond timeline of the device
+// The counter difference is taken modulo 2^32, so millis() and micros() rollovers are transparent
+int64_t unwrap_timestamp(SerialDevice *device, uint32_t counter) {
+    if (device->clock.samples == 0) {
+        // no data point was received yet, the timeline starts at the counter value
+        device->timeline = (int64_t) counter * device->timestamp_unit;
+    } else {
+        uint32_t delta = counter - device->last_counter;
+        if ((int32_t) delta < 0) {
+            // the counter went backwards, the device was reset or sent lines out of order
+            device->stats.counter_resets++;
+            delta = 0;
+        }
+        device->timeline += (int64_t) delta * device->timestamp_unit;
+    }
+    device->last_counter = counter;
+    return device->timeline;
+}
+
+// A function to append a data point taken at the given timeline position to the history of a device
+// The oldest data point is dropped when the history is full
+void append_data_point(SerialDevice *device, int64_t timestamp, DataPoint *data_point) {
+    if (device->buffer_size == 0) {
+        device->first_timestamp = timestamp;
+        data_point->delta = 0;
+    } else {
+        int64_t delta = timestamp - device->max_timestamp;
+        if (delta > UINT32_MAX) {
+            // gaps longer than 71 minutes are shortened, older data points move forward in time by the excess
+            device->first_timestamp += delta - UINT32_MAX;
+            delta = UINT32_MAX;
+        }
+        data_point->delta = delta;
+    }
+    if (device->buffer_size == MAX_DATA_POINTS) {
+        device->buffer_start = RING_INDEX(device->buffer_start + 1);
+        device->buffer_size--;
+        device->first_timestamp += device->buffer[device->buffer_start].delta;
+    }
+    device->buffer[RING_INDEX(device->buffer_start + device->buffer_size)] = *data_point;
+    device->buffer_size++;
+    device->max_timestamp = timestamp;
+    device->appends++;
+}
+
+// A function to set the fixed time window from the -w argument, the span of the x-axis in seconds, e.g. 10 or 0.5
+void parse_window_span(char *arg) {
+    double seconds;
+    if (sscanf(arg, "%lf", &seconds) != 1 || seconds * 1e6 < WINDOW_BUCKETS || seconds > 86400) {
+        fprintf(stderr, "Error: -w needs a time window from %g to 86400 s\n", WINDOW_BUCKETS / 1e6);
+        exit(1);
+    }
+    window_span = seconds * 1e6;
+    bucket_span = window_span / WINDOW_BUCKETS;
+}
+
+// A function to reduce a data point into the bucket of the fixed time window its timestamp falls into
+// Each bucket keeps the first, lowest, highest and last value of every data field, so the window costs the same memory and
+// drawing time at any sample rate. Buckets the timeline skipped since the previous data point are emptied
+void bucket_data_point(SerialDevice *device, int64_t timestamp, DataPoint *data_point) {
+    if (device->buckets == NULL) {
+        device->bucket_counts = calloc(WINDOW_BUCKETS, sizeof(uint32_t));
+        device->buckets = malloc((size_t) WINDOW_BUCKETS * MAX_DATA_FIELDS * 4 * sizeof(float));
+        if (device->bucket_counts == NULL || device->buckets == NULL) {
+            fprintf(stderr, "Error: Cannot allocate the time window of %s\n", device->name);
+            exit(1);
+        }
+        device->latest_bucket = timestamp / bucket_span;
+    }
+    int64_t bucket = timestamp / bucket_span;
+    if (bucket > device->latest_bucket) {
+        int64_t first = bucket - device->latest_bucket > WINDOW_BUCKETS ? bucket - WINDOW_BUCKETS + 1 : device->latest_bucket + 1;
+        for (int64_t b = first; b <= bucket; b++) {
+            device->bucket_counts[b & (WINDOW_BUCKETS - 1)] = 0;
+        }
+        device->latest_bucket = bucket;
+    }
+    int slot = bucket & (WINDOW_BUCKETS - 1);
+    float *values = device->buckets + (size_t) slot * MAX_DATA_FIELDS * 4;
+    for (int i = 0; i < device->num_fields; i++, values += 4) {
+        float value = data_point->values[i];
+        if (device->bucket_counts[slot] == 0) {
+            values[0] = values[1] = values[2] = value;
+        } else {
+            values[1] = value < values[1] ? value : values[1];
+            values[2] = value > values[2] ? value : values[2];
+        }
+        values[3] = value;
+    }
+    device->bucket_counts[slot]++;
+}
+
+// A function to handle one complete line received from a device at the given host time
+void ingest_line(SerialDevice *device, char *line, int length, double host_time) {
+    DataPoint data_point;
+    uint32_t counter;
+    int result = parse_data_point(device, line, length, &counter, &data_point);
+    if (result != PARSE_OK) {
+        device->stats.rejected[result]++;
+        log_ingest_error(device, host_time, parse_result_names[result], line);
+        return;
+    }
+    int64_t timestamp = unwrap_timestamp(device, counter);
+    if (device->backend != NULL && device->backend->recorded) {
+        // a recording is read in one go, its data points are placed as if they were received at the pace they were sent
+        if (device->clock.samples == 0) {
+            device->replay_origin = host_time - timestamp / 1000.0;
+        }
+        host_time = device->replay_origin + timestamp / 1000.0;
+    }
+    device->last_host_time = host_time;
+    update_clock_model(&device->clock, timestamp / 1000.0, host_time);
+    int64_t trace = trace_begin();
+    append_data_point(device, timestamp, &data_point);
+    trace_end(device->trace, TRACE_APPEND, trace);
+    device->stats.lines++;
+    if (window_span > 0) {
+        bucket_data_point(device, timestamp, &data_point);
+    }
+    if (density_mode) {
+        bin_data_point(device, timestamp, &data_point);
+    }
+    if (scope_mode) {
+        check_trigger(device, timestamp, &data_point);
+    }
+    if (data_point_hook != NULL) {
+        data_point_hook(device, counter, host_time);
+    }
+}
+
+// A function to split a chunk read from a device into lines and ingest the complete ones, all stamped with the given host time
+// A partial line is kept in the device until the chunk completing it arrives
+void frame_chunk(SerialDevice *device, char *chunk, int n, double host_time) {
+    device->stats.bytes += n;
+    int i = 0;
+    if (!device->synchronized) {
+        // Drop the partial line the port was opened in the middle of, only up to the first newline.
+        // The first complete line is validated by the parser like every other one, plotting starts with the first valid data point.
+        char *newline = memchr(chunk, '\n', n);
+        i = (newline == NULL) ? n : newline - chunk + 1;
+        device->stats.discarded += i;
+        device->synchronized = (newline != NULL);
+    }
+    for (; i < n; i++) {
+        char c = chunk[i];
+        // Check for newline
+        if (c == '\n') {
+            if (!device->truncating) {
+                ingest_line(device, device->line, device->line_length, host_time);
+            }
+            device->truncating = 0;
+            device->line_length = 0;
+            continue;
+        }
+        // Check for buffer overflow, the rest of an overlong line is dropped up to the next newline
+        if (device->truncating) {
+            continue;
+        }
+        if (device->line_length == LINE_SIZE - 1) {
+            device->stats.truncated++;
+            device->line[device->line_length] = '\0';
+            log_ingest_error(device, host_time, "line too long", device->line);
+            device->truncating = 1;
+            continue;
+        }
+        // Append the character to the line
+        device->line[device->line_length++] = c;
+    }
+}
+
+// A function to extend a value range to the minimum and maximum value among all data fields in the buckets of the fixed
+// time window of a device
+void bucket_value_range(SerialDevice *device, float *min_value, float *max_value) {
+    for (int slot = 0; slot < WINDOW_BUCKETS; slot++) {
+        if (device->bucket_counts[slot] == 0) {
+            continue;
+        }
+        float *values = device->buckets + (size_t) slot * MAX_DATA_FIELDS * 4;
+        for (int i = 0; i < device->num_fields; i++, values += 4) {
+            if (values[1] < *min_value) {
+                *min_value = values[1];
+            }
+            if (values[2] > *max_value) {
+                *max_value = values[2];
+            }
+        }
+    }
+}
+
+// A function to return the tick step of a value range, 1, 2 or 5 times a power of ten that divides it into at most
+// AUTOSCALE_TICKS steps
+double nice_step(double range) {
+    double magnitude = pow(10, floor(log10(range / AUTOSCALE_TICKS)));
+    double fraction = range / AUTOSCALE_TICKS / magnitude;
+    return (fraction <= 1 ? 1 : fraction <= 2 ? 2 : fraction <= 5 ? 5 : 10) * magnitude;
+}
+
+// A function to apply the autoscale policy to the value range found in the data of a device
+// The range shown snaps to multiples of a nice tick step around the data. It grows at once when the data leaves it, and
+// shrinks only once the data fit into a smaller nice range for autoscale_hysteresis seconds, so it stays still while the
+// data wanders inside it. Return 1 if the range shown changed
+int autoscale(SerialDevice *device, float data_min, float data_max, double now) {
+    float shown_min = device->min_value, shown_max = device->max_value;
+    int grow = (shown_min >= shown_max || data_min < shown_min || data_max > shown_max);
+    if (grow) {
+        // the new range covers the old one too, a shrink of the other side waits for the hysteresis
+        if (shown_min < shown_max) {
+            data_min = shown_min < data_min ? shown_min : data_min;
+            data_max = shown_max > data_max ? shown_max : data_max;
+        }
+    }
+    double step = nice_step(data_max - data_min);
+    float nice_min = floor(data_min / step) * step;
+    float nice_max = ceil(data_max / step) * step;
+    if (!grow) {
+        if (nice_min <= shown_min && nice_max >= shown_max) {
+            device->shrink_since = -1;
+            return 0;
+        }
+        if (device->shrink_since < 0) {
+            device->shrink_since = now;
+        }
+        if (now - device->shrink_since < autoscale_hysteresis * 1000.0) {
+            return 0;
+        }
+    }
+    device->shrink_since = -1;
+    device->min_value = nice_min;
+    device->max_value = nice_max;
+    return nice_min != shown_min || nice_max != shown_max;
+}
+
+// A function to update the graph parameters based on the data buffers
+// The value range of each device follows its data through autoscale(), graph.scale_changed tells the next frame whether one moved
+void update_graph() {
+    graph.span = 0;
+    graph.right_edge = 0;
+    int scale_changed = 0;
+    double now = host_time_ms();
+
+    for (int d = 0; d < num_devices; d++) {
+        SerialDevice *device = &devices[d];
+        device->min_timestamp = 0;
+        float min_value = 0;
+        float max_value = 1;
+
+        // If the buffer is not empty, update the graph parameters based on the data
+        if (device->buffer_size > 0) {
+            DataPoint *first = &device->buffer[device->buffer_start];
+            // The minimum timestamp is the first data point in the buffer, the maximum one is kept by append_data_point()
+            device->min_timestamp = device->first_timestamp;
+            // Set the minimum and maximum value to the first data value in the buffer
+            min_value = first->values[0];
+            max_value = first->values[0];
+            if (window_span > 0 && device->buckets != NULL) {
+                // the fixed time window shows the buckets, they may reach further back than the history
+                bucket_value_range(device, &min_value, &max_value);
+            } else {
+                // Loop through the buffer and find the minimum and maximum value among all data fields
+                for (int i = 0; i < device->buffer_size; i++) {
+                    DataPoint *point = &device->buffer[RING_INDEX(device->buffer_start + i)];
+                    for (int j = 0; j < device->num_fields; j++) {
+                        if (point->values[j] < min_value) {
+                            min_value = point->values[j];
+                        }
+                        if (point->values[j] > max_value) {
+                            max_value = point->values[j];
+                        }
+                    }
+                }
+            }
+
+            // Add some margin to the minimum and maximum value
+            float margin = (max_value - min_value) * INTERNAL_GRAPH_MARGIN;
+            min_value -= margin;
+            max_value += margin;
+
+            // If the minimum and maximum value are equal, set them to 0 and 1
+            if (min_value == max_value) {
+                min_value = 0;
+                max_value = 1;
+            }
+
+        }
+        // The range shown snaps to a nice one around the data and only shrinks after the hysteresis
+        if (autoscale(device, min_value, max_value, now)) {
+            scale_changed = 1;
+        }
+
+        // All devices share the widest time span, so equal distances on the x-axis mean equal time
+        if (device->buffer_size > 0 && device->max_timestamp - device->min_timestamp > graph.span) {
+            graph.span = device->max_timestamp - device->min_timestamp;
+        }
+        // The right edge is the latest sample of all devices, placed on the host timeline by its clock model
+        if (device->buffer_size > 0 && clock_model_host(&device->clock, device->max_timestamp / 1000.0) > graph.right_edge) {
+            graph.right_edge = clock_model_host(&device->clock, device->max_timestamp / 1000.0);
+        }
+    }
+
+    // If all timestamps are equal, show one second
+    if (graph.span == 0) {
+        graph.span = 1000000;
+    }
+    // A fixed time window keeps its span whatever the histories cover
+    if (window_span > 0) {
+        graph.span = window_span;
+    }
+    // the flag stays set until a frame was drawn with the new ranges
+    if (scale_changed) {
+        graph.scale_changed = 1;
+        graph.scale_changes++;
+    }
+}
+
+// A function to append the data points of one pixel column to points[], reduced to the first, lowest, highest and last one
+// A polyline through those four covers the same pixels as the one through all data points of the column
+// Return the new number of points
+int emit_column(int count, int x, int first, int low, int high, int last) {
+    int ys[4] = {first, low, high, last};
+    for (int k = 0; k < 4; k++) {
+        if (k == 0 || ys[k] != points[count - 1].y) {
+            points[count].x = x;
+            points[count].y = ys[k];
+            count++;
+        }
+    }
+    return count;
+}
+
+// A function to transform the history of one data field of a device into window coordinates in points[]
+// x_latest is the x position of the latest data point, bottom the y position of min_value
+// Data points falling into the same pixel column are decimated to their min/max, so the number of points
+// drawn is bounded by the width of the window instead of the depth of the history
+// Return the number of points
+int transform_points(SerialDevice *device, int field, double x_latest, double x_per_us, int bottom, float min_value, float y_factor) {
+    int64_t timestamp = device->first_timestamp;
+    int count = 0;
+    int column = INT_MIN, first = 0, low = 0, high = 0, last = 0;
+    // Loop through the buffer and transform the data points into window coordinates
+    for (int j = 0; j < device->buffer_size; j++) {
+        DataPoint *point = &device->buffer[RING_INDEX(device->buffer_start + j)];
+        // the timestamps are rebuilt from the deltas while walking the history
+        if (j > 0) {
+            timestamp += point->delta;
+        }
+        // Calculate the x and y coordinates of the data point on the window
+        double x_position = x_latest - (device->max_timestamp - timestamp) * x_per_us;
+        // samples left of the pane are clamped so the X protocol 16 bit coordinates never wrap
+        int x = (x_position < -MARGIN) ? -MARGIN : (int) x_position;
+        int y = bottom - (point->values[field] - min_value) * y_factor;
+        if (x != column) {
+            if (column != INT_MIN) {
+                count = emit_column(count, column, first, low, high, last);
+            }
+            column = x;
+            first = low = high = y;
+        }
+        if (y < low) {
+            low = y;
+        }
+        if (y > high) {
+            high = y;
+        }
+        last = y;
+    }
+    if (column != INT_MIN) {
+        count = emit_column(count, column, first, low, high, last);
+    }
+    return count;
+}
+
+// A function to transform the buckets of the fixed time window of one data field of a device into window coordinates in points[]
+// Like transform_points(), but every bucket is placed at its middle and brings its first, lowest, highest and last value
+// into the pixel column it falls into, so the number of points is bounded by the buckets and the width of the window
+// Return the number of points
+int transform_buckets(SerialDevice *device, int field, double x_latest, double x_per_us, int bottom, float min_value, float y_factor) {
+    int count = 0;
+    int column = INT_MIN, first = 0, low = 0, high = 0, last = 0;
+    if (device->buckets == NULL) {
+        return 0;
+    }
+    for (int64_t b = device->latest_bucket - WINDOW_BUCKETS + 1; b <= device->latest_bucket; b++) {
+        int slot = b & (WINDOW_BUCKETS - 1);
+        if (device->bucket_counts[slot] == 0) {
+            continue;
+        }
+        float *values = device->buckets + ((size_t) slot * MAX_DATA_FIELDS + field) * 4;
+        double x_position = x_latest - (device->max_timestamp - (b * bucket_span + bucket_span / 2)) * x_per_us;
+        int x = (x_position < -MARGIN) ? -MARGIN : (int) x_position;
+        if (x != column) {
+            if (column != INT_MIN) {
+                count = emit_column(count, column, first, low, high, last);
+            }
+            column = x;
+            first = low = high = bottom - (values[0] - min_value) * y_factor;
+        }
+        // the lowest value is the highest y position
+        int y_low = bottom - (values[1] - min_value) * y_factor;
+        int y_high = bottom - (values[2] - min_value) * y_factor;
+        if (y_high < low) {
+            low = y_high;
+        }
+        if (y_low > high) {
+            high = y_low;
+        }
+        last = bottom - (values[3] - min_value) * y_factor;
+    }
+    if (column != INT_MIN) {
+        count = emit_column(count, column, first, low, high, last);
+    }
+    return count;
+}
+
+// A function to append a point to the retained polyline of a data field, relative to the newest point
+void push_vertex(VertexCache *cache, int64_t x, int y) {
+    if (cache->end > cache->start && x - cache->last_x > INT16_MAX) {
+        // the older points lie further left than a window can be wide, they are dropped so the steps fit into 16 bits
+        cache->start = cache->end;
+    }
+    if (cache->end == cache->start) {
+        cache->first_x = x;
+        cache->first_y = y;
+    } else {
+        cache->points[cache->end].x = x - cache->last_x;
+        cache->points[cache->end].y = y - cache->last_y;
+    }
+    cache->end++;
+    cache->last_x = x;
+    cache->last_y = y;
+}
+
+// A function to append the open column of the retained polyline, reduced to its first, lowest, highest and last point like emit_column()
+void emit_vertex_column(VertexCache *cache) {
+    int ys[4] = {cache->first, cache->low, cache->high, cache->last};
+    for (int k = 0; k < 4; k++) {
+        if (k == 0 || ys[k] != cache->last_y) {
+            push_vertex(cache, cache->column, ys[k]);
+        }
+    }
+}
+
+// A function to drop the points of the retained polyline left of the column of the oldest data point in the history
+void evict_vertices(VertexCache *cache, int64_t first_column) {
+    while (cache->end > cache->start && cache->first_x < first_column) {
+        cache->start++;
+        if (cache->end > cache->start) {
+            cache->first_x += cache->points[cache->start].x;
+            cache->first_y += cache->points[cache->start].y;
+        }
+    }
+}
+
+// A function to make room for one more column at the end of the retained polyline
+// The evicted points are dropped first, then the rest moves to the front of the array, about once per PLOT_POINTS points
+void make_vertex_room(VertexCache *cache, int64_t first_column) {
+    if (cache->end + 4 <= VERTEX_CACHE_POINTS) {
+        return;
+    }
+    evict_vertices(cache, first_column);
+    memmove(cache->points, cache->points + cache->start, (cache->end - cache->start) * sizeof(PlotPoint));
+    cache->end -= cache->start;
+    cache->start = 0;
+}
+
+// A function to bring the retained polyline of one data field of a device up to date with its history
+// Only the data points appended since the previous frame are transformed, and the ones dropped from the history are evicted.
+// All of them are transformed again when the value range, the pane or the time scale changed, the time scale is only
+// considered changed once it would move the oldest data point by half a pixel
+void update_vertex_cache(SerialDevice *device, int field, double x_per_us, int bottom, float min_value, float y_factor) {
+    if (device->vertex_caches == NULL) {
+        device->vertex_caches = calloc(MAX_DATA_FIELDS, sizeof(VertexCache));
+        if (device->vertex_caches == NULL) {
+            fprintf(stderr, "Error: Cannot allocate the vertex cache of %s\n", device->name);
+            exit(1);
+        }
+    }
+    VertexCache *cache = &device->vertex_caches[field];
+    if (cache->points == NULL) {
+        cache->points = malloc(VERTEX_CACHE_POINTS * sizeof(PlotPoint));
+        if (cache->points == NULL) {
+            fprintf(stderr, "Error: Cannot allocate the vertex cache of %s\n", device->name);
+            exit(1);
+        }
+    }
+    int64_t span = device->max_timestamp - device->first_timestamp;
+    uint64_t fresh = device->appends - cache->appends;
+    int rebuild = (!cache->valid || cache->bottom != bottom || cache->min_value != min_value || cache->y_factor != y_factor ||
+                   fabs(x_per_us - cache->x_per_us) * span > 0.5 || fresh >= (uint64_t) device->buffer_size);
+    // walk back over the new data points to the one transformed last, it is not where it was if the history moved
+    int j = device->buffer_size - (int) fresh;
+    int64_t timestamp = device->max_timestamp;
+    if (!rebuild) {
+        for (int k = device->buffer_size - 1; k >= j; k--) {
+            timestamp -= device->buffer[RING_INDEX(device->buffer_start + k)].delta;
+        }
+        rebuild = timestamp != cache->last_timestamp;
+    }
+    if (rebuild) {
+        cache->start = cache->end = 0;
+        cache->column = INT64_MIN;
+        cache->valid = 1;
+        cache->x_per_us = x_per_us;
+        cache->bottom = bottom;
+        cache->min_value = min_value;
+        cache->y_factor = y_factor;
+        j = 0;
+        timestamp = device->first_timestamp - device->buffer[device->buffer_start].delta;
+    }
+    int64_t first_column = floor(device->first_timestamp * cache->x_per_us);
+    for (; j < device->buffer_size; j++) {
+        DataPoint *point = &device->buffer[RING_INDEX(device->buffer_start + j)];
+        timestamp += point->delta;
+        int64_t x = floor(timestamp * cache->x_per_us);
+        int y = bottom - (point->values[field] - min_value) * y_factor;
+        if (x != cache->column) {
+            if (cache->column != INT64_MIN) {
+                make_vertex_room(cache, first_column);
+                emit_vertex_column(cache);
+            }
+            cache->column = x;
+            cache->first = cache->low = cache->high = y;
+        }
+        if (y < cache->low) {
+            cache->low = y;
+        }
+        if (y > cache->high) {
+            cache->high = y;
+        }
+        cache->last = y;
+    }
+    cache->appends = device->appends;
+    cache->last_timestamp = device->max_timestamp;
+    evict_vertices(cache, first_column);
+    make_vertex_room(cache, first_column);
+}
+
+// A function to draw the history of one data field of a device from its retained polyline brought up to date by update_vertex_cache()
+// x_latest is the x position of the latest data point, like for transform_points(). The open column is appended for the draw only,
+// and the oldest point is the only one moved to where the frame has it
+// Return 0 without drawing when the polyline cannot be drawn that way, the caller then transforms the history itself
+int draw_cached_series(PlotRenderer *renderer, int color, SerialDevice *device, int field, double x_latest) {
+    VertexCache *cache = &device->vertex_caches[field];
+    VertexCache closed = *cache;
+    emit_vertex_column(cache);
+    // the newest column is at x_latest, the others keep their distance to it
+    int64_t x = cache->first_x + (int64_t) floor(x_latest) - cache->column;
+    int drawn = x >= INT16_MIN && x <= INT16_MAX;
+    if (drawn) {
+        cache->points[cache->start].x = x;
+        cache->points[cache->start].y = cache->first_y;
+        renderer->draw_polyline_relative(renderer->context, color, cache->points + cache->start, cache->end - cache->start);
+    }
+    *cache = closed;
+    return drawn;
+}
+
+// A function to return the color of the text and axes in the current color theme
+int foreground_color() {
+    return color_theme == 1 ? COLOR_WHITE : COLOR_BLACK;
+}
+
+// A function to return the background color in the current color theme
+int background_color() {
+    return color_theme == 1 ? COLOR_BLACK : COLOR_WHITE;
+}
+
+// A function to find the value range over all devices of a pane
+void pane_value_range(SerialDevice *pane_devices, int count, float *min_value, float *max_value) {
+    *min_value = pane_devices[0].min_value;
+    *max_value = pane_devices[0].max_value;
+    for (int d = 1; d < count; d++) {
+        if (pane_devices[d].min_value < *min_value) {
+            *min_value = pane_devices[d].min_value;
+        }
+        if (pane_devices[d].max_value > *max_value) {
+            *max_value = pane_devices[d].max_value;
+        }
+    }
+}
+
+// A function to draw the static part of a pane: a gray grid line and a label at every tick step of the value range and,
+// for a fixed time window, the time labels of the x-axis. It only changes with the scale and the layout
+void draw_pane_grid(PlotRenderer *renderer, SerialDevice *pane_devices, int count, int top, int height) {
+    float min_value, max_value;
+    pane_value_range(pane_devices, count, &min_value, &max_value);
+    char label[128];
+    float y_factor = (height - 1 * MARGIN) / (max_value - min_value);
+    double step = nice_step(max_value - min_value);
+    // the range is a multiple of the step since autoscale(), the first tick is searched anyway for merged ranges
+    for (double tick = ceil(min_value / step) * step; tick <= max_value + step / 1000; tick += step) {
+        int y = top + height - MARGIN - (tick - min_value) * y_factor;
+        renderer->draw_line(renderer->context, COLOR_GRAY, MARGIN, y, graph.width, y);
+        // ticks close to 0 are printed as 0, not as the rounding error of the sum
+        sprintf(label, "%g", fabs(tick) < step / 1000 ? 0.0 : tick);
+        renderer->draw_text(renderer->context, foreground_color(), 0, y < top + MARGIN ? top + MARGIN : y, label);
+    }
+    if (window_span > 0) {
+        sprintf(label, "-%g s", window_span / 1e6);
+        renderer->draw_text(renderer->context, foreground_color(), MARGIN, top + height - MARGIN + MARGIN/2, label);
+        renderer->draw_text(renderer->context, foreground_color(), graph.width - MARGIN - 40, top + height - MARGIN + MARGIN/2, "0 s");
+    }
+}
+
+// A function to draw the static layer of the time plot: the background, the pane separators and the grid of every pane
+void draw_static_layer(PlotRenderer *renderer) {
+    renderer->fill_rectangle(renderer->context, background_color(), 0, 0, graph.width, graph.height);
+    if (merged_view || num_devices == 1) {
+        draw_pane_grid(renderer, devices, num_devices, 0, graph.height);
+    } else {
+        // stack one pane per device, separated by a gray line
+        int pane_height = graph.height / num_devices;
+        for (int d = 0; d < num_devices; d++) {
+            if (d > 0) {
+                renderer->draw_line(renderer->context, COLOR_GRAY, 0, d * pane_height, graph.width, d * pane_height);
+            }
+            draw_pane_grid(renderer, &devices[d], 1, d * pane_height, pane_height);
+        }
+    }
+}
+
+// A function to tell whether the static layer shown by the previous frame is out of date: a value range, the window size,
+// the color theme or the layout changed, or the previous frame was drawn by another mode
+int static_layer_changed() {
+    static int width = -1, height, theme, merged, count, fixed;
+    int current_merged = merged_view || num_devices == 1;
+    int changed = (graph.scale_changed || !static_layer_valid || width != graph.width || height != graph.height ||
+                   theme != color_theme || merged != current_merged || count != num_devices || fixed != (window_span > 0));
+    width = graph.width;
+    height = graph.height;
+    theme = color_theme;
+    merged = current_merged;
+    count = num_devices;
+    fixed = window_span > 0;
+    static_layer_valid = 1;
+    return changed;
+}
+
+// A function to draw the history of one or more devices in a pane of the window, over its static layer
+// Samples are placed on the host timeline by the clock model of their device, so devices line up in time
+// The pane covers graph.span microseconds up to graph.right_edge
+void draw_pane(PlotRenderer *renderer, SerialDevice *pane_devices, int count, int top, int height) {
+    float min_value, max_value;
+    pane_value_range(pane_devices, count, &min_value, &max_value);
+
+    // Draw the x-axis labels, they move with the data, those of a fixed time window are part of the static layer
+    char label[128];
+    double left_edge = graph.right_edge - graph.span / 1000.0; // host time at the left edge of the pane
+    if (window_span == 0 && count == 1) {
+        // label the edges with the device timestamps they correspond to
+        sprintf(label, "%.1f ms", clock_model_device(&pane_devices[0].clock, left_edge));
+        renderer->draw_text(renderer->context, foreground_color(), MARGIN, top + height - MARGIN + MARGIN/2, label);
+        sprintf(label, "%.1f ms", clock_model_device(&pane_devices[0].clock, graph.right_edge));
+        renderer->draw_text(renderer->context, foreground_color(), graph.width - MARGIN - 40, top + height - MARGIN + MARGIN/2, label);
+    } else if (window_span == 0) {
+        sprintf(label, "-%.1f ms", graph.span / 1000.0);
+        renderer->draw_text(renderer->context, foreground_color(), MARGIN, top + height - MARGIN + MARGIN/2, label);
+        renderer->draw_text(renderer->context, foreground_color(), graph.width - MARGIN - 40, top + height - MARGIN + MARGIN/2, "0 ms");
+    }
+
+    // Draw the per-device ingest statistics in the top right corner of the pane
+    for (int d = 0; d < count; d++) {
+        SerialDevice *device = &pane_devices[d];
+        snprintf(label, sizeof(label), "%s: %.0f lines/s, %u lines, %u rejected, drift %+.0f ppm, jitter %.2f ms%s",
+                device->name, device->line_rate, device->stats.lines, rejected_lines(&device->stats),
+                clock_model_drift_ppm(&device->clock), clock_model_jitter(&device->clock), device->fd == -1 ? ", closed" : "");
+        renderer->draw_text(renderer->context, foreground_color(), graph.width / 2, top + MARGIN + d * 12, label);
+    }
+
+    double x_factor = ( (double) graph.width * 1000.0 / graph.span ); // pixels per host millisecond, calculate once to optimize loops
+    float y_factor = (height - 1 * MARGIN) / (max_value - min_value);
+    for (int d = 0; d < count; d++) {
+        SerialDevice *device = &pane_devices[d];
+        int color_shift = (count > 1) ? (int) (device - devices) : 0; // tell merged devices apart
+        // x position of the latest data point and pixels per device microsecond
+        // the data points are placed relative to the latest one using exact 64 bit differences, so the
+        // precision does not depend on how far along the timeline the device is
+        double x_latest = (clock_model_host(&device->clock, device->max_timestamp / 1000.0) - left_edge) * x_factor;
+        double x_per_us = device->clock.rate * x_factor / 1000.0;
+        // Draw the data points and lines with different colors for each data field
+        for (int i = 0; i < device->num_fields; i++) {
+            int color = graph.colors[(i + color_shift) % MAX_DATA_FIELDS];
+            if (renderer->draw_series != NULL && window_span == 0) {
+                renderer->draw_series(renderer->context, color, device, i, x_latest, x_per_us, top + height - MARGIN, min_value, y_factor);
+                continue;
+            }
+            int64_t probe = show_perf ? perf_now() : 0;
+            // the retained polyline only transforms the data points appended since the previous frame
+            if (renderer->draw_polyline_relative != NULL && window_span == 0 && device->buffer_size > 0) {
+                update_vertex_cache(device, i, x_per_us, top + height - MARGIN, min_value, y_factor);
+                if (show_perf) {
+                    perf_transform_time += perf_now() - probe;
+                }
+                if (draw_cached_series(renderer, color, device, i, x_latest)) {
+                    continue;
+                }
+                probe = show_perf ? perf_now() : 0;
+            }
+            int n = (window_span > 0) ? transform_buckets(device, i, x_latest, x_per_us, top + height - MARGIN, min_value, y_factor)
+                                      : transform_points(device, i, x_latest, x_per_us, top + height - MARGIN, min_value, y_factor);
+            if (show_perf) {
+                perf_transform_time += perf_now() - probe;
+            }
+            renderer->draw_polyline(renderer->context, color, points, n);
+        }
+    }
+}
+
+// A function to draw the ingest statistics of all devices in a box over the graph
+void draw_stats_overlay(PlotRenderer *renderer) {
+    char text[3][160];
+    renderer->fill_rectangle(renderer->context, background_color(), MARGIN, MARGIN, graph.width - 2 * MARGIN, num_devices * 3 * 12 + 8);
+    renderer->draw_rectangle(renderer->context, COLOR_GRAY, MARGIN, MARGIN, graph.width - 2 * MARGIN, num_devices * 3 * 12 + 8);
+    for (int d = 0; d < num_devices; d++) {
+        format_ingest_stats(&devices[d], text);
+        for (int l = 0; l < 3; l++) {
+            renderer->draw_text(renderer->context, foreground_color(), MARGIN + 4, MARGIN + 14 + (d * 3 + l) * 12, text[l]);
+        }
+    }
+}
+
+// A function to draw the performance overlay in a box in the bottom left corner of the window
+void draw_perf_overlay(PlotRenderer *renderer) {
+    char text[PERF_STAGES + 2][128];
+    int lines = 0;
+    float line_rate = 0;
+    for (int d = 0; d < num_devices; d++) {
+        line_rate += devices[d].line_rate;
+    }
+    snprintf(text[lines++], 128, "ingest %.0f lines/s, %.1f samples/frame, %lu requests/frame, %lu rescales",
+             line_rate, perf_samples_per_frame, perf_requests, graph.scale_changes);
+    for (int s = 0; s < PERF_STAGES; s++) {
+        double p50, p99;
+        if (perf_percentiles(&perf_stages[s], &p50, &p99)) {
+            snprintf(text[lines++], 128, "%-15s p50 %9.1f us  p99 %9.1f us", perf_stage_names[s], p50, p99);
+        } else {
+            snprintf(text[lines++], 128, "%-15s -", perf_stage_names[s]);
+        }
+    }
+    int top = graph.height - MARGIN - lines * 12 - 8;
+    renderer->fill_rectangle(renderer->context, background_color(), MARGIN, top, 360, lines * 12 + 8);
+    renderer->draw_rectangle(renderer->context, COLOR_GRAY, MARGIN, top, 360, lines * 12 + 8);
+    for (int l = 0; l < lines; l++) {
+        renderer->draw_text(renderer->context, foreground_color(), MARGIN + 4, top + 14 + l * 12, text[l]);
+    }
+}
+
+// A function to set the XY mode from the -X argument: the x and y data field counted from 1, and optionally the number of
+// data points plotted again when the mode starts over, e.g. 1,2 or 1,2,512
+void parse_xy_mode(char *arg) {
+    int x_field, y_field, samples = XY_SAMPLES;
+    if (sscanf(arg, "%d,%d,%d", &x_field, &y_field, &samples) < 2 || x_field < 1 || x_field > MAX_DATA_FIELDS ||
+        y_field < 1 || y_field > MAX_DATA_FIELDS || samples < 2 || samples > MAX_DATA_POINTS) {
+        fprintf(stderr, "Error: -X needs <x field>,<y field>[,<samples>] with fields from 1 to %d and 2 to %d samples\n",
+                MAX_DATA_FIELDS, MAX_DATA_POINTS);
+        exit(1);
+    }
+    xy_fields[0] = x_field - 1;
+    xy_fields[1] = y_field - 1;
+    xy_samples = samples;
+    xy_mode = 1;
+}
+
+// A function to set the density mode from the -D argument, the duration of one sweep in milliseconds, e.g. 20 or 0.5
+void parse_density_mode(char *arg) {
+    double sweep_ms;
+    if (sscanf(arg, "%lf", &sweep_ms) != 1 || sweep_ms * 1000 < 1 || sweep_ms > 60000) {
+        fprintf(stderr, "Error: -D needs a sweep duration from 0.001 to 60000 ms\n");
+        exit(1);
+    }
+    density_sweep = sweep_ms * 1000;
+    density_mode = 1;
+}
+
+// A function to give a raster the size of the window, all pixels become background with the next render_raster()
+// It only allocates when the size changes, never per frame or data point
+void resize_raster(Raster *raster, int width, int height) {
+    size_t n = (size_t) width * height;
+    if (width != raster->width || height != raster->height || raster->intensity == NULL) {
+        raster->intensity = realloc(raster->intensity, n * sizeof(float));
+        raster->color = realloc(raster->color, n);
+        raster->pixels = realloc(raster->pixels, n * sizeof(uint32_t));
+        // the hits start cleared, add_hits() clears the frame hits again after each frame
+        free(raster->hits);
+        free(raster->frame_hits);
+        raster->hits = calloc(n, sizeof(float));
+        raster->frame_hits = calloc(n, sizeof(float));
+        if (n > 0 && (raster->intensity == NULL || raster->color == NULL || raster->pixels == NULL ||
+                      raster->hits == NULL || raster->frame_hits == NULL)) {
+            fprintf(stderr, "Error: Cannot allocate a %dx%d raster\n", width, height);
+            exit(1);
+        }
+        raster->width = width;
+        raster->height = height;
+    }
+    raster->fade = 0;
+    raster->lines = 0;
+}
+
+// A function to multiply the intensity of every pixel of a raster by a factor, 4 pixels per vector operation
+void fade_raster(Raster *raster, float factor) {
+    float *intensity = raster->intensity;
+    size_t n = (size_t) raster->width * raster->height;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        v4sf values;
+        memcpy(&values, intensity + i, sizeof(values));
+        values *= factor;
+        memcpy(intensity + i, &values, sizeof(values));
+    }
+    for (; i < n; i++) {
+        intensity[i] *= factor;
+    }
+}
+
+// A function to draw a line into a raster with Bresenham's algorithm, the pixels get at least the given intensity
+void draw_raster_line(Raster *raster, int x0, int y0, int x1, int y1, float intensity, int color) {
+    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int error = dx + dy;
+    for (;;) {
+        if (x0 >= 0 && x0 < raster->width && y0 >= 0 && y0 < raster->height) {
+            size_t i = (size_t) y0 * raster->width + x0;
+            if (intensity >= raster->intensity[i]) {
+                raster->intensity[i] = intensity;
+                raster->color[i] = color;
+            }
+        }
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+        int e2 = 2 * error;
+        if (e2 >= dy) {
+            error += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            error += dx;
+            y0 += sy;
+        }
+    }
+}
+
+// A function to make the XRGB8888 image of a raster, each pixel its color blended over the background by its intensity
+// The blends are looked up in a table of 256 intensity steps per palette color, made again only when the background changes
+void present_raster(Raster *raster, int background) {
+    static uint32_t blends[COLORS][256];
+    static int blends_background = -1;
+    if (background != blends_background) {
+        for (int c = 0; c < COLORS; c++) {
+            for (int s = 0; s < 256; s++) {
+                uint32_t pixel = 0;
+                for (int k = 0; k < 3; k++) {
+                    float value = palette_rgb[background][k] + (palette_rgb[c][k] - palette_rgb[background][k]) * s / 255.0f;
+                    pixel = (pixel << 8) | (uint32_t) (value * 255.0f + 0.5f);
+                }
+                blends[c][s] = pixel;
+            }
+        }
+        blends_background = background;
+    }
+    size_t n = (size_t) raster->width * raster->height;
+    for (size_t i = 0; i < n; i++) {
+        raster->pixels[i] = blends[raster->color[i]][(int) (raster->intensity[i] * 255.0f)];
+    }
+}
+
+// A function to fade the intensities of a raster by its fade factor and add the hits binned until the latest frame,
+// 4 pixels per vector operation, the hits are cleared for the frame after the next one
+void add_hits(Raster *raster) {
+    float *intensity = raster->intensity;
+    float *hits = raster->frame_hits;
+    size_t n = (size_t) raster->width * raster->height;
+    v4sf zero = {0, 0, 0, 0};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        v4sf values, counts;
+        memcpy(&values, intensity + i, sizeof(values));
+        memcpy(&counts, hits + i, sizeof(counts));
+        values = values * raster->fade + counts;
+        memcpy(intensity + i, &values, sizeof(values));
+        memcpy(hits + i, &zero, sizeof(zero));
+    }
+    for (; i < n; i++) {
+        intensity[i] = intensity[i] * raster->fade + hits[i];
+        hits[i] = 0;
+    }
+}
+
+// A function to bring the raster up to date with the latest frame and make its image: the fade pass, then the lines of the
+// XY mode or the hits of the density mode, then present_raster() or present_density()
+// The passes cost O(width * height) whatever the sample rate, they only touch the raster, never the histories, so a front end
+// with defer_raster set runs them after it released its lock. It does nothing after a frame without a raster
+void render_raster() {
+    size_t n = (size_t) raster.width * raster.height;
+    if (raster.fade == 0 && raster.mode != RASTER_NONE) {
+        // the raster started over, it may hold the pixels of another size or mode
+        memset(raster.intensity, 0, n * sizeof(float));
+        memset(raster.color, 0, n);
+    }
+    if (raster.mode == RASTER_XY) {
+        if (raster.fade != 0) {
+            fade_raster(&raster, raster.fade);
+        }
+        for (int i = 0; i < raster.lines; i++) {
+            RasterLine *line = &raster_lines[i];
+            draw_raster_line(&raster, line->x0, line->y0, line->x1, line->y1, line->intensity, line->color);
+        }
+        raster.lines = 0;
+        present_raster(&raster, raster.background);
+    } else if (raster.mode == RASTER_DENSITY) {
+        add_hits(&raster);
+        present_density(&raster, raster.background);
+    }
+}
+
+// A function to approximate the base 2 logarithm of 4 positive floats from their exponent and mantissa bits
+// The mantissa term is a parabola through log2 at 1 and 2, it is monotonic and off by less than 0.01
+v4sf log2_approx(v4sf x) {
+    v4si bits = (v4si) x;
+    v4sf exponent = __builtin_convertvector(((bits >> 23) & 0xff) - 127, v4sf);
+    v4sf mantissa = (v4sf) ((bits & 0x7fffff) | 0x3f800000) - 1.0f;
+    return exponent + mantissa * (1.3465f - 0.3465f * mantissa);
+}
+
+// A function to return the highest intensity of a raster, 4 pixels per vector operation
+float max_intensity(Raster *raster) {
+    float *intensity = raster->intensity;
+    size_t n = (size_t) raster->width * raster->height;
+    v4sf maxima = {0, 0, 0, 0};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        v4sf values;
+        memcpy(&values, intensity + i, sizeof(values));
+        v4si greater = values > maxima;
+        maxima = (v4sf) (((v4si) values & greater) | ((v4si) maxima & ~greater));
+    }
+    float result = 0;
+    for (int k = 0; k < 4; k++) {
+        result = maxima[k] > result ? maxima[k] : result;
+    }
+    for (; i < n; i++) {
+        result = intensity[i] > result ? intensity[i] : result;
+    }
+    return result;
+}
+
+// A function to make the XRGB8888 image of the density mode, the hit count of each pixel mapped to a color by its logarithm
+// relative to the highest count, from the background through blue, cyan, green and yellow to red
+// The logarithms are computed 4 pixels at a time, the colors are looked up in a table of 256 steps
+// The table only depends on the background, the highest count scales the logarithms onto it, so it is made again only when
+// the background changes
+void present_density(Raster *raster, int background) {
+    static const int stops[] = {COLOR_BLUE, COLOR_CYAN, COLOR_GREEN, COLOR_YELLOW, COLOR_RED};
+    static uint32_t colormap[256];
+    static int colormap_background = -1;
+    if (background != colormap_background) {
+        for (int s = 0; s < 256; s++) {
+            // the first 32 steps fade in from the background, the rest runs through the stops
+            float position = s < 32 ? 0 : (s - 32) / 223.0f * 4;
+            int stop = position >= 4 ? 3 : (int) position;
+            float weight = position - stop;
+            uint32_t pixel = 0;
+            for (int k = 0; k < 3; k++) {
+                float value = palette_rgb[stops[stop]][k] + (palette_rgb[stops[stop + 1]][k] - palette_rgb[stops[stop]][k]) * weight;
+                if (s < 32) {
+                    value = palette_rgb[background][k] + (value - palette_rgb[background][k]) * s / 32.0f;
+                }
+                pixel = (pixel << 8) | (uint32_t) (value * 255.0f + 0.5f);
+            }
+            colormap[s] = pixel;
+        }
+        colormap_background = background;
+    }
+    float *intensity = raster->intensity;
+    size_t n = (size_t) raster->width * raster->height;
+    v4sf highest = {0, 0, 0, 0};
+    highest += 1.0f + max_intensity(raster);
+    // log2_approx is monotonic, so the highest count maps to 255 at most
+    float scale = 255.0f / log2_approx(highest)[0];
+    if (!isfinite(scale)) {
+        scale = 0;
+    }
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        v4sf values;
+        memcpy(&values, intensity + i, sizeof(values));
+        v4si steps = __builtin_convertvector(log2_approx(values + 1.0f) * scale, v4si);
+        for (int k = 0; k < 4; k++) {
+            raster->pixels[i + k] = colormap[steps[k]];
+        }
+    }
+    for (; i < n; i++) {
+        v4sf values = {intensity[i], 0, 0, 0};
+        raster->pixels[i] = colormap[(int) (log2_approx(values + 1.0f)[0] * scale)];
+    }
+}
+
+// A function to choose the value range and the rectangle of the density plot of a device, the range covers all data fields
+// of its history with some margin
+void set_density_plot(SerialDevice *device, DensityPlot *plot, int left, int top, int width, int height) {
+    float min_value = INFINITY, max_value = -INFINITY;
+    for (int j = 0; j < device->buffer_size; j++) {
+        DataPoint *point = &device->buffer[RING_INDEX(device->buffer_start + j)];
+        for (int i = 0; i < device->num_fields; i++) {
+            if (point->values[i] < min_value) {
+                min_value = point->values[i];
+            }
+            if (point->values[i] > max_value) {
+                max_value = point->values[i];
+            }
+        }
+    }
+    if (min_value > max_value) {
+        // no data point yet
+        min_value = max_value = 0;
+    }
+    if (min_value == max_value) {
+        min_value -= 0.5;
+        max_value += 0.5;
+    }
+    float margin = (max_value - min_value) * DENSITY_RANGE_MARGIN;
+    plot->min = min_value - margin;
+    plot->max = max_value + margin;
+    plot->left = left;
+    plot->bottom = top + height - 1;
+    plot->x_per_us = (float) (width - 1) / density_sweep;
+    plot->y_factor = (height - 1) / (plot->max - plot->min);
+    // a pane too small for the plot still makes a valid plot, only an empty one, so the frames do not start over again and again
+    plot->empty = width <= 1 || height <= 1;
+    plot->valid = device->buffer_size > 0;
+}
+
+// A function to count the samples of a data point into the hits of the density mode, called as it is ingested
+// Its position in the current sweep gives the column, each data field hits one pixel of it
+// The range checks and the pixel offsets are computed for 4 fields per vector operation, only the increments are scalar
+// since two fields can hit the same pixel
+// A value outside of the range invalidates the plot, the next frame starts over with a range that fits it
+void bin_data_point(SerialDevice *device, int64_t timestamp, DataPoint *data_point) {
+    DensityPlot *plot = &density_plots[device - devices];
+    // until the density mode drew a frame, the raster may have another size or belong to another mode
+    if (!plot->valid || plot->empty || raster.mode != RASTER_DENSITY) {
+        return;
+    }
+    int vectors = (device->num_fields + 3) / 4;
+    int offsets[MAX_DATA_FIELDS];
+    v4sf minimum = {0, 0, 0, 0};
+    minimum += plot->min;
+    v4si outside = {0, 0, 0, 0};
+    for (int h = 0; h < vectors; h++) {
+        v4si lanes = {4 * h, 4 * h + 1, 4 * h + 2, 4 * h + 3};
+        v4sf values;
+        memcpy(&values, data_point->values + 4 * h, sizeof(values));
+        // the lanes past the data fields of the device hold no samples
+        v4si fields = lanes < device->num_fields;
+        v4si inside = fields & (values >= plot->min) & (values <= plot->max);
+        outside |= fields & ~inside;
+        // the lanes without a sample in the range are placed at the minimum, so every lane converts to a row inside the plot
+        v4sf placed = (v4sf) (((v4si) values & inside) | ((v4si) minimum & ~inside));
+        v4si rows = plot->bottom - __builtin_convertvector((placed - plot->min) * plot->y_factor, v4si);
+        v4si row_offsets = rows * raster.width;
+        memcpy(offsets + 4 * h, &row_offsets, sizeof(row_offsets));
+    }
+    if (outside[0] | outside[1] | outside[2] | outside[3]) {
+        // rare: a sample outside of the range starts the plot over
+        plot->valid = 0;
+        return;
+    }
+    float *column = raster.hits + plot->left + (int) ((timestamp % density_sweep) * plot->x_per_us);
+    for (int i = 0; i < device->num_fields; i++) {
+        column[offsets[i]] += 1.0f;
+    }
+}
+
+// A function to draw one frame of the density mode: every pane shows how often the samples of its device hit each pixel,
+// with the time axis folded into sweeps, like the intensity graded display of an oscilloscope
+// The samples are binned as they are ingested, a frame costs one fade pass and one image whatever the sample rate, both made
+// by render_raster(), the layout only hands the hits over
+// The raster starts over, with the history binned again, when the window changes, a value leaves the range or another
+// mode drew into the raster
+void draw_density_frame(PlotRenderer *renderer) {
+    static double last_frame = 0;
+    static int last_layout = -1;
+    double now = host_time_ms();
+    int merged = merged_view || num_devices == 1;
+    int pane_height = merged ? graph.height : graph.height / num_devices;
+    int restart = (raster.mode != RASTER_DENSITY || raster.width != graph.width || raster.height != graph.height ||
+                   merged != last_layout);
+    for (int d = 0; d < num_devices; d++) {
+        restart |= (devices[d].buffer_size > 0 && !density_plots[d].valid);
+    }
+    if (restart) {
+        resize_raster(&raster, graph.width, graph.height);
+        // the frame hits are clear, the hits of another size or mode may not be
+        memset(raster.hits, 0, (size_t) raster.width * raster.height * sizeof(float));
+        raster.mode = RASTER_DENSITY;
+        last_layout = merged;
+        for (int d = 0; d < num_devices; d++) {
+            SerialDevice *device = &devices[d];
+            int top = merged ? 0 : d * pane_height;
+            set_density_plot(device, &density_plots[d], MARGIN, top + MARGIN, graph.width - 2 * MARGIN, pane_height - 2 * MARGIN);
+            int64_t timestamp = device->first_timestamp;
+            for (int j = 0; j < device->buffer_size; j++) {
+                DataPoint *point = &device->buffer[RING_INDEX(device->buffer_start + j)];
+                if (j > 0) {
+                    timestamp += point->delta;
+                }
+                bin_data_point(device, timestamp, point);
+            }
+        }
+    } else {
+        raster.fade = expf(-(now - last_frame) / 1000.0f / DENSITY_PERSISTENCE);
+    }
+    last_frame = now;
+    // the hits binned so far go to render_raster(), the ingest bins into the other buffer, cleared by the previous one
+    float *hits = raster.frame_hits;
+    raster.frame_hits = raster.hits;
+    raster.hits = hits;
+    raster.background = background_color();
+    if (!defer_raster) {
+        render_raster();
+    }
+    renderer->draw_image(renderer->context, 0, 0, raster.width, raster.height, raster.pixels);
+
+    char label[128];
+    for (int d = 0; d < num_devices; d++) {
+        SerialDevice *device = &devices[d];
+        DensityPlot *plot = &density_plots[d];
+        int top = merged ? 0 : d * pane_height;
+        int row = merged ? d : 0;
+        if (!merged && d > 0) {
+            renderer->draw_line(renderer->context, COLOR_GRAY, 0, top, graph.width, top);
+        }
+        if (row == 0) {
+            renderer->draw_text(renderer->context, foreground_color(), MARGIN, top + pane_height - MARGIN + MARGIN/2, "0 ms");
+            sprintf(label, "%.3g ms", density_sweep / 1000.0);
+            renderer->draw_text(renderer->context, foreground_color(), graph.width - MARGIN - 40, top + pane_height - MARGIN + MARGIN/2, label);
+            sprintf(label, "%.2f", plot->min);
+            renderer->draw_text(renderer->context, foreground_color(), 0, top + pane_height - MARGIN, label);
+            sprintf(label, "%.2f", plot->max);
+            renderer->draw_text(renderer->context, foreground_color(), 0, top + MARGIN, label);
+        }
+        snprintf(label, sizeof(label), "%s: density of %d fields, %.0f lines/s", device->name, device->num_fields, device->line_rate);
+        renderer->draw_text(renderer->context, foreground_color(), graph.width / 2, top + MARGIN + row * 12, label);
+    }
+}
+
+// A function to tell whether the frame shows a fading raster, the front ends then redraw without new data
+int raster_animating() {
+    return xy_mode || density_mode;
+}
+
+// A function to set the scope mode from the -T argument: the data field counted from 1, the trigger level, and optionally
+// the edge (r for rising, f for falling), the capture window in milliseconds, the share of it before the trigger in percent
+// and the holdoff in milliseconds, e.g. 1,0.5 or 2,-10,f,5,50,100
+void parse_scope_mode(char *arg) {
+    int field, pre_percent = SCOPE_PRE_TRIGGER;
+    char edge = 'r';
+    double window_ms = SCOPE_WINDOW / 1000.0, holdoff_ms = 0;
+    if (sscanf(arg, "%d,%f,%c,%lf,%d,%lf", &field, &scope_trigger.level, &edge, &window_ms, &pre_percent, &holdoff_ms) < 2 ||
+        field < 1 || field > MAX_DATA_FIELDS || (edge != 'r' && edge != 'f') || window_ms * 1000 < 1 || window_ms > 60000 ||
+        pre_percent < 0 || pre_percent > 100 || holdoff_ms < 0) {
+        fprintf(stderr, "Error: -T needs <field>,<level>[,r|f[,<window ms>[,<pre-trigger %%>[,<holdoff ms>]]]] with a field from 1 to %d\n",
+                MAX_DATA_FIELDS);
+        exit(1);
+    }
+    scope_trigger.field = field - 1;
+    scope_trigger.rising = (edge == 'r');
+    scope_trigger.window = window_ms * 1000;
+    scope_trigger.pre = scope_trigger.window * pre_percent / 100;
+    scope_trigger.holdoff = holdoff_ms * 1000;
+    scope_mode = 1;
+}
+
+// A function to copy the data points of the window around the latest trigger out of the history of a device into its capture
+// The window starts scope_trigger.pre before the trigger, a history too short for that gives a capture starting later
+// The value range of the capture covers its data points and the trigger level
+void capture_window(SerialDevice *device, ScopeState *scope) {
+    SerialDevice *capture = &scope->capture;
+    // walk back from the latest data point to the first one inside the window
+    double start = scope->trigger_time - scope_trigger.pre;
+    int64_t timestamp = device->max_timestamp;
+    int j = device->buffer_size - 1;
+    while (j > 0 && timestamp - device->buffer[RING_INDEX(device->buffer_start + j)].delta >= start) {
+        timestamp -= device->buffer[RING_INDEX(device->buffer_start + j)].delta;
+        j--;
+    }
+    capture->name = device->name;
+    capture->num_fields = device->num_fields;
+    capture->buffer_start = 0;
+    capture->buffer_size = device->buffer_size - j;
+    capture->first_timestamp = timestamp;
+    capture->max_timestamp = device->max_timestamp;
+    capture->min_value = scope_trigger.level;
+    capture->max_value = scope_trigger.level;
+    for (int k = 0; k < capture->buffer_size; k++) {
+        DataPoint *point = &device->buffer[RING_INDEX(device->buffer_start + j + k)];
+        capture->buffer[k] = *point;
+        for (int i = 0; i < device->num_fields; i++) {
+            if (point->values[i] < capture->min_value) {
+                capture->min_value = point->values[i];
+            }
+            if (point->values[i] > capture->max_value) {
+                capture->max_value = point->values[i];
+            }
+        }
+    }
+    float margin = (capture->max_value - capture->min_value) * INTERNAL_GRAPH_MARGIN;
+    capture->min_value -= margin;
+    capture->max_value += margin;
+    if (capture->min_value == capture->max_value) {
+        capture->min_value -= 0.5;
+        capture->max_value += 0.5;
+    }
+    scope->capture_trigger = scope->trigger_time;
+    scope->captures++;
+}
+
+// A function to evaluate the trigger of the scope mode on a data point, called as it is ingested
+// It fires when the trigger field crosses the level on the chosen edge, unless the previous trigger is less than the
+// holdoff ago or its capture is still incomplete. Once the part of the window after it was received, the window is captured
+void check_trigger(SerialDevice *device, int64_t timestamp, DataPoint *data_point) {
+    ScopeState *scope = &scope_states[device - devices];
+    if (scope_trigger.field >= device->num_fields) {
+        return;
+    }
+    float value = data_point->values[scope_trigger.field];
+    if (scope->pending) {
+        if (timestamp >= scope->trigger_time + (scope_trigger.window - scope_trigger.pre)) {
+            scope->pending = 0;
+            capture_window(device, scope);
+        }
+    } else if (scope->armed && timestamp >= scope->trigger_time + scope_trigger.holdoff) {
+        float level = scope_trigger.level;
+        int crossed = scope_trigger.rising ? (scope->last_value < level && value >= level) : (scope->last_value > level && value <= level);
+        if (crossed) {
+            // place the trigger where the line between the two data points crosses the level, so captures line up below a sample
+            scope->trigger_time = scope->last_timestamp + (double) (timestamp - scope->last_timestamp) * (level - scope->last_value) / (value - scope->last_value);
+            scope->pending = 1;
+        }
+    }
+    scope->armed = 1;
+    scope->last_value = value;
+    scope->last_timestamp = timestamp;
+}
+
+// A function to tell whether a device completed a capture that the latest frame of the scope mode did not draw
+int new_capture() {
+    uint32_t captures = 0;
+    for (int d = 0; d < num_devices; d++) {
+        captures += scope_states[d].captures;
+    }
+    return captures != scope_drawn;
+}
+
+// A function to draw the latest captures of one or more devices in a pane of the window, the trigger at a fixed position
+void draw_scope_pane(PlotRenderer *renderer, int first, int count, int top, int height) {
+    float min_value = INFINITY, max_value = -INFINITY;
+    for (int d = first; d < first + count; d++) {
+        SerialDevice *capture = &scope_states[d].capture;
+        if (scope_states[d].captures > 0 && capture->min_value < min_value) {
+            min_value = capture->min_value;
+        }
+        if (scope_states[d].captures > 0 && capture->max_value > max_value) {
+            max_value = capture->max_value;
+        }
+    }
+    if (min_value > max_value) {
+        min_value = scope_trigger.level - 0.5;
+        max_value = scope_trigger.level + 0.5;
+    }
+
+    char label[128];
+    double x_per_us = (double) graph.width / scope_trigger.window;
+    double x_trigger = scope_trigger.pre * x_per_us;
+    sprintf(label, "%.1f ms", -scope_trigger.pre / 1000.0);
+    renderer->draw_text(renderer->context, foreground_color(), MARGIN, top + height - MARGIN + MARGIN/2, label);
+    sprintf(label, "+%.1f ms", (scope_trigger.window - scope_trigger.pre) / 1000.0);
+    renderer->draw_text(renderer->context, foreground_color(), graph.width - MARGIN - 40, top + height - MARGIN + MARGIN/2, label);
+    sprintf(label, "%.2f", min_value);
+    renderer->draw_text(renderer->context, foreground_color(), 0, top + height - MARGIN, label);
+    sprintf(label, "%.2f", max_value);
+    renderer->draw_text(renderer->context, foreground_color(), 0, top + MARGIN, label);
+
+    // the trigger position and level are marked by gray lines crossing at the trigger point
+    float y_factor = (height - MARGIN) / (max_value - min_value);
+    int bottom = top + height - MARGIN;
+    int y_level = bottom - (scope_trigger.level - min_value) * y_factor;
+    renderer->draw_line(renderer->context, COLOR_GRAY, x_trigger, top, x_trigger, top + height);
+    renderer->draw_line(renderer->context, COLOR_GRAY, 0, y_level, graph.width, y_level);
+
+    for (int d = first; d < first + count; d++) {
+        ScopeState *scope = &scope_states[d];
+        SerialDevice *device = &devices[d];
+        if (scope_trigger.field >= device->num_fields) {
+            snprintf(label, sizeof(label), "%s: no data field %d to trigger on", device->name, scope_trigger.field + 1);
+        } else {
+            snprintf(label, sizeof(label), "%s: field %d %s through %.2f, %u captures%s", device->name, scope_trigger.field + 1,
+                     scope_trigger.rising ? "rising" : "falling", scope_trigger.level, scope->captures,
+                     scope->captures == 0 ? ", waiting for a trigger" : "");
+        }
+        renderer->draw_text(renderer->context, foreground_color(), graph.width / 2, top + MARGIN + (d - first) * 12, label);
+        if (scope->captures == 0) {
+            continue;
+        }
+        int color_shift = (count > 1) ? d : 0;
+        double x_latest = x_trigger + (scope->capture.max_timestamp - scope->capture_trigger) * x_per_us;
+        for (int i = 0; i < device->num_fields; i++) {
+            int n = transform_points(&scope->capture, i, x_latest, x_per_us, bottom, min_value, y_factor);
+            renderer->draw_polyline(renderer->context, graph.colors[(i + color_shift) % MAX_DATA_FIELDS], points, n);
+        }
+    }
+}
+
+// A function to draw one frame of the scope mode: the latest capture of every device, in its own pane or merged
+// The front ends only draw it when new_capture() tells them a trigger completed a capture
+void draw_scope_frame(PlotRenderer *renderer) {
+    if (merged_view || num_devices == 1) {
+        draw_scope_pane(renderer, 0, num_devices, 0, graph.height);
+    } else {
+        int pane_height = graph.height / num_devices;
+        for (int d = 0; d < num_devices; d++) {
+            if (d > 0) {
+                renderer->draw_line(renderer->context, COLOR_GRAY, 0, d * pane_height, graph.width, d * pane_height);
+            }
+            draw_scope_pane(renderer, d, 1, d * pane_height, pane_height);
+        }
+    }
+    scope_drawn = 0;
+    for (int d = 0; d < num_devices; d++) {
+        scope_drawn += scope_states[d].captures;
+    }
+}
+
+// A function to choose the axis ranges of an XY plot from the latest data points of its device, with some margin
+void set_xy_ranges(SerialDevice *device, XYPlot *plot, int count) {
+    for (int a = 0; a < 2; a++) {
+        float min_value = INFINITY, max_value = -INFINITY;
+        for (int j = device->buffer_size - count; j < device->buffer_size; j++) {
+            float value = device->buffer[RING_INDEX(device->buffer_start + j)].values[xy_fields[a]];
+            if (value < min_value) {
+                min_value = value;
+            }
+            if (value > max_value) {
+                max_value = value;
+            }
+        }
+        if (min_value == max_value) {
+            min_value -= 0.5;
+            max_value += 0.5;
+        }
+        float margin = (max_value - min_value) * XY_RANGE_MARGIN;
+        plot->min[a] = min_value - margin;
+        plot->max[a] = max_value + margin;
+    }
+}
+
+// A function to check whether the data points appended to a device since the latest frame fit into the axes of its XY plot
+// Return 1 if the plot has to start over, with new ranges from the latest xy_samples data points
+int check_xy_ranges(SerialDevice *device, XYPlot *plot) {
+    int count = device->buffer_size < xy_samples ? device->buffer_size : xy_samples;
+    uint32_t appended = device->stats.lines - plot->lines;
+    if (plot->valid && appended < (uint32_t) count) {
+        int fits = 1;
+        for (int j = device->buffer_size - appended; j < device->buffer_size && fits; j++) {
+            DataPoint *point = &device->buffer[RING_INDEX(device->buffer_start + j)];
+            for (int a = 0; a < 2; a++) {
+                float value = point->values[xy_fields[a]];
+                fits &= (value >= plot->min[a] && value <= plot->max[a]);
+            }
+        }
+        if (fits) {
+            return 0;
+        }
+    }
+    set_xy_ranges(device, plot, count);
+    return 1;
+}
+
+// A function to lay out the data points of a device as connected lines in a rectangle of the window, render_raster() draws them
+// A valid plot only gets the data points appended since the latest frame at full intensity, otherwise the latest
+// xy_samples are plotted again with the intensity their age would have faded them to
+void plot_xy(SerialDevice *device, XYPlot *plot, int left, int top, int width, int height, int color) {
+    int count = device->buffer_size < xy_samples ? device->buffer_size : xy_samples;
+    uint32_t appended = device->stats.lines - plot->lines;
+    // the first data point a line ends at, the line from the one before it is drawn too
+    int first = device->buffer_size - count + 1;
+    if (plot->valid && appended < (uint32_t) count) {
+        first = device->buffer_size - appended;
+    }
+    float x_factor = (width - 1) / (plot->max[0] - plot->min[0]);
+    float y_factor = (height - 1) / (plot->max[1] - plot->min[1]);
+    // walk backwards from the latest data point, its age is known from the deltas
+    int64_t age = 0;
+    DataPoint *point = &device->buffer[RING_INDEX(device->buffer_start + device->buffer_size - 1)];
+    int x1 = left + (point->values[xy_fields[0]] - plot->min[0]) * x_factor;
+    int y1 = top + height - 1 - (point->values[xy_fields[1]] - plot->min[1]) * y_factor;
+    for (int j = device->buffer_size - 1; j >= first && j >= 1; j--) {
+        float intensity = plot->valid ? 1.0f : expf(-age / 1e6f / XY_PERSISTENCE);
+        age += point->delta;
+        point = &device->buffer[RING_INDEX(device->buffer_start + j - 1)];
+        int x0 = left + (point->values[xy_fields[0]] - plot->min[0]) * x_factor;
+        int y0 = top + height - 1 - (point->values[xy_fields[1]] - plot->min[1]) * y_factor;
+        // at most MAX_DATA_POINTS - 1 lines per device and frame, drawn by render_raster()
+        raster_lines[raster.lines++] = (RasterLine) {x0, y0, x1, y1, intensity, color};
+        x1 = x0;
+        y1 = y0;
+    }
+    plot->valid = 1;
+    plot->lines = device->stats.lines;
+}
+
+// A function to draw the axis labels of the XY plot of a device in a pane
+void draw_xy_labels(PlotRenderer *renderer, SerialDevice *device, XYPlot *plot, int top, int height, int row) {
+    char label[128];
+    if (row == 0) {
+        sprintf(label, "%.2f", plot->min[0]);
+        renderer->draw_text(renderer->context, foreground_color(), MARGIN, top + height - MARGIN + MARGIN/2, label);
+        sprintf(label, "%.2f", plot->max[0]);
+        renderer->draw_text(renderer->context, foreground_color(), graph.width - MARGIN - 40, top + height - MARGIN + MARGIN/2, label);
+        sprintf(label, "%.2f", plot->min[1]);
+        renderer->draw_text(renderer->context, foreground_color(), 0, top + height - MARGIN, label);
+        sprintf(label, "%.2f", plot->max[1]);
+        renderer->draw_text(renderer->context, foreground_color(), 0, top + MARGIN, label);
+    }
+    if (xy_fields[0] >= device->num_fields || xy_fields[1] >= device->num_fields) {
+        snprintf(label, sizeof(label), "%s: no data field %d", device->name, (xy_fields[0] > xy_fields[1] ? xy_fields[0] : xy_fields[1]) + 1);
+    } else {
+        snprintf(label, sizeof(label), "%s: field %d against field %d, %.0f lines/s", device->name, xy_fields[1] + 1, xy_fields[0] + 1, device->line_rate);
+    }
+    renderer->draw_text(renderer->context, foreground_color(), graph.width / 2, top + MARGIN + row * 12, label);
+}
+
+// A function to draw one frame of the XY mode: every device plots one data field against another, in its own pane or merged
+// The traces persist in the raster and fade out, a frame costs one fade pass, the lines of the new data points and one image,
+// made by render_raster() from the lines laid out here
+// The raster starts over, with every trace plotted again from the history, when the window changes or an axis has to grow
+void draw_xy_frame(PlotRenderer *renderer) {
+    static double last_frame = 0;
+    static int last_layout = -1;
+    double now = host_time_ms();
+    int merged = merged_view || num_devices == 1;
+    int restart = (raster.mode != RASTER_XY || raster.width != graph.width || raster.height != graph.height ||
+                   merged != last_layout);
+    for (int d = 0; d < num_devices; d++) {
+        if (devices[d].buffer_size >= 2 && xy_fields[0] < devices[d].num_fields && xy_fields[1] < devices[d].num_fields) {
+            restart |= check_xy_ranges(&devices[d], &xy_plots[d]);
+        }
+    }
+    if (restart) {
+        resize_raster(&raster, graph.width, graph.height);
+        raster.mode = RASTER_XY;
+        for (int d = 0; d < num_devices; d++) {
+            xy_plots[d].valid = 0;
+        }
+        last_layout = merged;
+    } else {
+        raster.fade = expf(-(now - last_frame) / 1000.0f / XY_PERSISTENCE);
+    }
+    last_frame = now;
+    raster.lines = 0;
+
+    int pane_height = merged ? graph.height : graph.height / num_devices;
+    for (int d = 0; d < num_devices; d++) {
+        SerialDevice *device = &devices[d];
+        int top = merged ? 0 : d * pane_height;
+        if (device->buffer_size >= 2 && xy_fields[0] < device->num_fields && xy_fields[1] < device->num_fields) {
+            plot_xy(device, &xy_plots[d], MARGIN, top + MARGIN, graph.width - 2 * MARGIN, pane_height - 2 * MARGIN,
+                    graph.colors[d % MAX_DATA_FIELDS]);
+        }
+    }
+    raster.background = background_color();
+    if (!defer_raster) {
+        render_raster();
+    }
+    renderer->draw_image(renderer->context, 0, 0, raster.width, raster.height, raster.pixels);
+
+    for (int d = 0; d < num_devices; d++) {
+        int top = merged ? 0 : d * pane_height;
+        if (!merged && d > 0) {
+            renderer->draw_line(renderer->context, COLOR_GRAY, 0, top, graph.width, top);
+        }
+        draw_xy_labels(renderer, &devices[d], &xy_plots[d], top, pane_height, merged ? d : 0);
+    }
+}
+
+// A function to draw one frame: the background, one pane per device or one merged pane, and the statistics overlay
+void draw_frame(PlotRenderer *renderer) {
+    if (density_mode || xy_mode) {
+        static_layer_valid = 0;
+        if (density_mode) {
+            draw_density_frame(renderer);
+        } else {
+            draw_xy_frame(renderer);
+        }
+        if (show_stats) {
+            draw_stats_overlay(renderer);
+        }
+        return;
+    }
+    // the raster modes start over when they come back
+    raster.mode = RASTER_NONE;
+
+    if (scope_mode) {
+        static_layer_valid = 0;
+        renderer->fill_rectangle(renderer->context, background_color(), 0, 0, graph.width, graph.height);
+        draw_scope_frame(renderer);
+    } else {
+        // the background, grid and labels come from the static layer, only the data is drawn again
+        int rebuild = static_layer_changed();
+        if (renderer->static_layer != NULL) {
+            renderer->static_layer(renderer->context, rebuild, draw_static_layer);
+        } else {
+            draw_static_layer(renderer);
+        }
+        if (merged_view || num_devices == 1) {
+            draw_pane(renderer, devices, num_devices, 0, graph.height);
+        } else {
+            int pane_height = graph.height / num_devices;
+            for (int d = 0; d < num_devices; d++) {
+                draw_pane(renderer, &devices[d], 1, d * pane_height, pane_height);
+            }
+        }
+        graph.scale_changed = 0;
+    }
+
+    if (show_stats) {
+        draw_stats_overlay(renderer);
+    }
+}
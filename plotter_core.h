@@ -0,0 +1,451 @@
+// The plotter core shared by the front ends: line framer, CSV parser, per-device history store, clock model,
+// autoscaling, decimation and the layout of the panes and overlays.
+// Data comes in through a source backend (serial port, pseudo terminal, recorded file, TCP or unix socket), every backend
+// ends in a non-blocking file descriptor the front end reads chunks from and hands to frame_chunk().
+// Drawing goes out through a render backend, a PlotRenderer with a few primitives the front end implements for its window system.
+// The core keeps its state in globals like the plotters always did, one front end per process.
+#ifndef PLOTTER_CORE_H
+#define PLOTTER_CORE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <linux/serial.h>
+
+#define BAUD_RATE 115200 // default baud rate, any other rate can be given with -b
+
+#define MAX_DATA_FIELDS 8 // Maximum number of data fields to plot
+#define MAX_DEVICES 16 // Maximum number of serial devices plotted by one process
+#define MARGIN 20 // Margin around the graph
+#define INTERNAL_GRAPH_MARGIN 0.001 // Margin for min/max values
+#define AUTOSCALE_TICKS 5 // tick steps the value range of a pane is divided into, the range snaps to multiples of one
+#define AUTOSCALE_HYSTERESIS 2.0 // default seconds the data has to fit into a smaller range before a pane shrinks to it
+
+#define COLOR_BLACK 0 // Color index for black
+#define COLOR_RED 1 // Color index for red
+#define COLOR_GREEN 2 // Color index for green
+#define COLOR_BLUE 3 // Color index for blue
+#define COLOR_YELLOW 4 // Color index for yellow
+#define COLOR_MAGENTA 5 // Color index for magenta
+#define COLOR_CYAN 6 // Color index for cyan
+#define COLOR_GRAY 7 // Color index for white
+#define COLOR_WHITE 8 // Color index for white
+#define COLORS 9 // Number of colors in the palette
+
+#define MAX_DATA_POINTS 2048 // Maximum number of data points to store (power of two, the history is a ring buffer)
+#define RING_INDEX(i) ((i) & (MAX_DATA_POINTS - 1)) // wrap an index into the history ring buffer
+#define LINE_SIZE 256 // max line size (line buffer)
+#define SERIAL_READ_CHUNK 4096 // how many bytes are read from a source per event loop wakeup
+#define LOG_INTERVAL 1000.0 // minimum milliseconds between two ingest error messages of one device, the others are counted
+#define CLOCK_MODEL_FORGETTING 0.999 // weight kept by older samples of the device/host clock regression for each new sample
+#define CLOCK_MODEL_MIN_SAMPLES 16 // samples needed before the clock drift is estimated, before that only the offset is
+#define PERF_SAMPLES 256 // latest timings kept per stage for the p50/p99 of the performance overlay
+#define TRACE_EVENTS (1 << 18) // events kept by the trace ring of a thread (power of two), older ones are overwritten
+#define XY_SAMPLES 1024 // latest data points the XY mode plots again when it starts over, -X can change it
+#define XY_PERSISTENCE 0.5 // seconds the trace of the XY mode takes to fade to 1/e
+#define XY_RANGE_MARGIN 0.1 // share of the value range added on each side of the axes of the XY mode
+#define DENSITY_PERSISTENCE 0.5 // seconds the hit counts of the density mode take to decay to 1/e
+#define DENSITY_SWEEP 20000 // default duration of one sweep of the density mode, in microseconds
+#define DENSITY_RANGE_MARGIN 0.1 // share of the value range added above and below the samples of the density mode
+#define SCOPE_WINDOW 20000 // default duration of a capture of the scope mode, in microseconds
+#define SCOPE_PRE_TRIGGER 25 // default share of a capture before the trigger, in percent
+#define WINDOW_BUCKETS 2048 // min/max buckets a fixed time window is divided into (power of two), whatever the sample rate
+#define PLOT_POINTS (4 * WINDOW_BUCKETS) // window coordinates a data field can be decimated to, 4 per history point or bucket
+#define VERTEX_CACHE_POINTS (2 * PLOT_POINTS + 8) // window coordinates retained per data field, twice what the history decimates to so it is compacted rarely
+
+// A structure to store a data point
+// The history stores the time delta to the previous data point, so the 64 bit timeline costs no more memory than the old uint32_t timestamp
+typedef struct {
+    uint32_t delta; // Microseconds since the previous data point in the history
+    float values[MAX_DATA_FIELDS]; // Data values
+} DataPoint;
+
+// A structure to store the graph parameters
+typedef struct {
+    uint16_t width; // Window width
+    uint16_t height; // Window height
+    int64_t span; // Time span shared by all devices on the x-axis, in microseconds
+    double right_edge; // Host time at the right edge of the x-axis, in milliseconds since start
+    int colors[MAX_DATA_FIELDS]; // Colors for each data field
+    int scale_changed; // Whether update_graph() changed the value range of a device since the latest frame, everything drawn with the old one is stale
+    unsigned long scale_changes; // Number of update_graph() calls that changed a value range
+} Graph;
+
+// A structure to store the running linear regression of host receive time against device timestamp
+// host = origin_host + offset + rate * (device - origin_device), all in milliseconds
+// The origin follows the latest sample so the weighted sums stay well conditioned
+typedef struct {
+    double origin_device; // Device timestamp of the regression origin
+    double origin_host; // Host receive time of the regression origin
+    double sw, sx, sy, sxx, sxy; // Exponentially weighted regression sums relative to the origin
+    double offset; // Estimated host time at the origin, relative to origin_host
+    double rate; // Estimated host milliseconds per device millisecond
+    double jitter_mean; // Weighted mean of the receive time residuals
+    double jitter_var; // Weighted variance of the receive time residuals
+    uint32_t samples; // Number of samples fed into the regression
+} ClockModel;
+
+// Stages timed for the performance overlay
+enum {
+    PERF_PARSE, // Framing and parsing of one chunk read from a source
+    PERF_AUTOSCALE, // update_graph(), the value ranges and the time span
+    PERF_TRANSFORM, // Data points to window coordinates, per frame
+    PERF_DRAW, // Drawing calls of one frame
+    PERF_FRAME_INTERVAL, // Time between two frames drawn by the redraw timer
+    PERF_LOCK, // Time a render thread holds the lock of the core for one frame, the autoscale and the layout
+    PERF_STAGES // Number of timed stages
+};
+// Names of the timed stages shown in the performance overlay
+extern const char *perf_stage_names[PERF_STAGES];
+
+// Pipeline events recorded by the tracing mode
+enum {
+    TRACE_READ, // read() of a chunk from a source
+    TRACE_PARSE, // Framing and parsing of the chunk
+    TRACE_APPEND, // Appending one data point to the history
+    TRACE_AUTOSCALE, // update_graph()
+    TRACE_RENDER, // Drawing one frame
+    TRACE_FLUSH, // Handing the frame to the display server
+    TRACE_NAMES // Number of event names
+};
+// Names of the pipeline events in the trace
+extern const char *trace_names[TRACE_NAMES];
+
+// A structure to store one traced event, its begin and end are recorded together when it ends
+typedef struct {
+    int64_t begin; // CLOCK_MONOTONIC_RAW time the event began, in nanoseconds
+    uint32_t duration; // Duration of the event, in nanoseconds
+    uint32_t name; // Index into trace_names
+} TraceEvent;
+
+// A structure to store the events of one thread, only that thread writes into it so no lock is needed
+typedef struct {
+    TraceEvent *events; // TRACE_EVENTS events, allocated and touched before the capture starts
+    uint32_t next; // Number of events recorded, the ring index is next modulo TRACE_EVENTS
+    int tid; // Thread id shown in the trace
+} TraceRing;
+
+// A structure to store the latest timings of one stage
+typedef struct {
+    uint32_t samples[PERF_SAMPLES]; // Ring buffer of the latest durations, in nanoseconds
+    uint32_t count; // Number of durations recorded since the overlay was switched on
+} PerfStage;
+
+// Results of parsing a received line, everything but PARSE_OK is a reason to reject the line
+enum {
+    PARSE_OK, // The line is a valid data point
+    REJECT_EMPTY, // The line is empty
+    REJECT_TIMESTAMP, // The timestamp is not a number
+    REJECT_VALUE, // A data value is not a finite number ("nan", "inf" and overflows are rejected too)
+    REJECT_FIELD_COUNT, // The number of data values does not match the number of data fields
+    PARSE_RESULTS // Number of parse results
+};
+// Names of the parse results used in the statistics and log messages
+extern const char *parse_result_names[PARSE_RESULTS];
+
+// A structure to store the ingest health counters of a device
+typedef struct {
+    uint64_t bytes; // Bytes read from the source
+    uint32_t lines; // Data points accepted into the history
+    uint32_t discarded; // Bytes of the partial first line dropped to synchronize with the source
+    uint32_t rejected[PARSE_RESULTS]; // Lines rejected by the parser, per reason
+    uint32_t truncated; // Lines longer than LINE_SIZE, dropped up to the next newline
+    uint32_t counter_resets; // How many times the device timestamp counter went backwards
+    uint32_t suppressed; // Log messages suppressed by the rate limit since the last message
+    double last_log; // Host time of the last log message, in milliseconds since start
+    int icount_supported; // Whether the driver reports its counters with TIOCGICOUNT
+    struct serial_icounter_struct icount_base; // Driver counters when the device was opened
+    struct serial_icounter_struct icount; // Latest driver counters
+} IngestStats;
+
+// A structure to store the window coordinates of a data point, laid out like the XPoint of Xlib
+typedef struct {
+    int16_t x;
+    int16_t y;
+} PlotPoint;
+
+// A structure to store the window coordinates of the history of one data field, kept from frame to frame while the scale stays
+// The columns are counted on the device timeline, so scrolling moves the whole polyline without changing its points.
+// Every point after the first is stored relative to the previous one like the CoordModePrevious of Xlib,
+// so the oldest points are dropped and new ones appended without touching the others
+typedef struct {
+    PlotPoint *points; // VERTEX_CACHE_POINTS points, allocated by the first frame drawing the data field
+    int start; // Index of the oldest point, its entry is only filled in when the polyline is drawn
+    int end; // Index after the newest point
+    int64_t first_x; // Column of the oldest point
+    int first_y; // y position of the oldest point
+    int64_t last_x; // Column of the newest point
+    int last_y; // y position of the newest point
+    int64_t column; // Column of the newest data points, it stays open for more of them and is emitted when the next column starts
+    int first, low, high, last; // y positions of the first, lowest, highest and last data point of the open column
+    uint64_t appends; // SerialDevice.appends of the newest data point transformed
+    int64_t last_timestamp; // Timeline position of the newest data point transformed
+    int valid; // Whether the points were transformed with the scale below
+    double x_per_us; // Columns per device microsecond
+    int bottom; // y position of min_value
+    float min_value; // Value at the bottom of the pane
+    float y_factor; // Pixels per value unit
+} VertexCache;
+
+typedef struct SerialDevice SerialDevice;
+
+// A structure to describe a source backend
+// Every backend opens its address as a non-blocking file descriptor, reading and closing it is the same for all of them
+typedef struct {
+    const char *prefix; // Prefix of the device name selecting the backend, e.g. "tcp:"
+    const char *name; // Name shown in the statistics
+    void (*open)(SerialDevice *device, const char *address); // Open the address into device->fd, exit on error
+    int recorded; // Whether the data is read much faster than it was sent, its device timestamps then stand in for the receive times
+} SourceBackend;
+
+// A structure to store one device together with its ingest state and history
+struct SerialDevice {
+    char *name; // Device name as given on the command line, with the backend prefix
+    const SourceBackend *backend; // Source backend the device is read through
+    int fd; // File descriptor of the source, -1 once the device is closed
+    uint8_t num_fields; // Number of data fields sent by the device
+    int synchronized; // Whether the first newline was received, the bytes before it are the tail of a line sent before the port was opened
+    uint16_t timestamp_unit; // Microseconds per device timestamp count, 1000 for millis() and 1 for micros()
+    uint32_t last_counter; // Raw device timestamp counter of the latest data point
+    int64_t timeline; // Unwrapped device time of the latest data point, in microseconds
+    char line[LINE_SIZE]; // Partial line assembled from the chunks
+    int line_length; // Number of characters in the partial line
+    int truncating; // Whether the rest of an overlong line is being dropped
+    DataPoint buffer[MAX_DATA_POINTS]; // History ring buffer
+    int buffer_start; // Ring index of the oldest data point
+    int buffer_size; // Number of data points in the history
+    int64_t first_timestamp; // Device time of the oldest data point in the history, in microseconds
+    int64_t min_timestamp; // Minimum timestamp in the data, in microseconds
+    int64_t max_timestamp; // Maximum timestamp in the data, in microseconds
+    float min_value; // Minimum of the value range shown, a nice range around the data
+    float max_value; // Maximum of the value range shown
+    double shrink_since; // Host time since which the data fits into a smaller nice range, -1 while it does not
+    IngestStats stats; // Ingest health counters
+    uint32_t lines_at_last_stats; // Value of stats.lines when the rate was last computed
+    float line_rate; // Accepted lines per second
+    double last_host_time; // Host receive time of the latest line, in milliseconds since start
+    ClockModel clock; // Device to host clock model
+    double replay_origin; // Host time of device time zero for a recorded source, in milliseconds since start
+    TraceRing *trace; // Trace ring the append events are recorded into
+    uint32_t *bucket_counts; // Data points in each bucket of the fixed time window, allocated by its first data point
+    float *buckets; // First, lowest, highest and last value of each data field in each bucket of the fixed time window, MAX_DATA_FIELDS per bucket
+    int64_t latest_bucket; // Number of the bucket of the latest data point, bucket n starts at n * bucket_span on the timeline
+    uint64_t appends; // Data points appended to the history since the device was initialized
+    VertexCache *vertex_caches; // Retained window coordinates of every data field, allocated by the first frame drawing them
+};
+
+// A structure to store an off-screen persistence image as large as the window
+// Every pixel has an intensity that fades over time and the palette color it was last drawn with,
+// the image shown is that color blended over the background by the intensity
+typedef struct {
+    int width; // Width in pixels
+    int height; // Height in pixels
+    float *intensity; // Intensity of each pixel, 0 is the background and 1 the full color
+    uint8_t *color; // Palette color of each pixel
+    uint32_t *pixels; // XRGB8888 image of the raster, rows of width pixels, made by present_raster()
+    float *hits; // Hits the density mode binned since the latest frame, one count per pixel
+    float *frame_hits; // Hits binned until the latest frame, render_raster() adds them to the intensities and clears them
+    float fade; // Factor render_raster() fades the intensities by, 0 makes all pixels background
+    int background; // Palette color of the background at the latest frame
+    int lines; // Lines of the XY mode in raster_lines, render_raster() draws them
+    int mode; // Mode that drew the raster last (RASTER_NONE...), a mode starts over when another one drew in between
+} Raster;
+
+// A structure to store one line of the XY mode laid out by a frame, drawn into the raster by render_raster()
+typedef struct {
+    int x0, y0, x1, y1; // End points in window coordinates
+    float intensity; // Intensity the line is drawn with
+    int color; // Palette color
+} RasterLine;
+
+// Modes drawing into the raster
+enum {
+    RASTER_NONE, // The time plot, it does not use the raster
+    RASTER_XY, // The XY mode, intensities with the palette color of each pixel
+    RASTER_DENSITY, // The density mode, decayed hit counts
+};
+
+// A structure to store the XY plot of one device, the axis ranges only grow while its trace persists
+typedef struct {
+    int valid; // Whether the trace in the raster is up to date with the ranges
+    uint32_t lines; // stats.lines of the device at the latest frame, the data points since are plotted next
+    float min[2]; // Minimum of the x and the y axis
+    float max[2]; // Maximum of the x and the y axis
+} XYPlot;
+
+// Vectors of 4 floats and 4 ints, one SSE or NEON register, the raster passes work on 4 pixels at a time
+typedef float v4sf __attribute__((vector_size(16)));
+typedef int32_t v4si __attribute__((vector_size(16)));
+
+// A structure to store the density plot of one device, its samples are binned into the raster as they are ingested
+typedef struct {
+    int valid; // Whether the plot has its geometry and range and its hits are in the raster, otherwise the next frame starts over
+    int empty; // Whether the pane has no room for the plot, a valid plot that counts no hits
+    float min; // Minimum of the value axis
+    float max; // Maximum of the value axis
+    int left; // Left edge of the plot in the window
+    int bottom; // Bottom row of the plot in the window
+    float x_per_us; // Pixels per microsecond of the sweep
+    float y_factor; // Pixels per value unit
+} DensityPlot;
+
+// A structure to store the trigger settings of the scope mode, the same for every device
+typedef struct {
+    int field; // Data field the trigger watches
+    float level; // Level the data field has to cross
+    int rising; // 1 to fire when the data field rises through the level, 0 when it falls through it
+    int64_t window; // Duration of a capture, in microseconds
+    int64_t pre; // Part of the capture before the trigger, in microseconds
+    int64_t holdoff; // Time after a trigger during which the next one is ignored, in microseconds
+} ScopeTrigger;
+
+// A structure to store the trigger state and the latest capture of one device in the scope mode
+typedef struct {
+    int armed; // Whether the previous value of the trigger field is known
+    float last_value; // Previous value of the trigger field
+    int64_t last_timestamp; // Timeline position of the previous value
+    int pending; // Whether the trigger fired and the part of the capture after it is still being received
+    double trigger_time; // Timeline position of the latest trigger, interpolated between the data points around the crossing
+    double capture_trigger; // Timeline position of the trigger of the capture
+    uint32_t captures; // Number of completed captures
+    SerialDevice capture; // The latest capture, a copy of the history around the trigger that transform_points() can draw
+} ScopeState;
+
+// A structure to describe a render backend: the drawing primitives the core lays out a frame with
+// Colors are indices into the palette (COLOR_BLACK...), the backend maps them to its own pixels
+typedef struct PlotRenderer PlotRenderer;
+struct PlotRenderer {
+    void *context; // Backend state passed to every primitive
+    void (*fill_rectangle)(void *context, int color, int x, int y, int width, int height);
+    void (*draw_rectangle)(void *context, int color, int x, int y, int width, int height);
+    void (*draw_line)(void *context, int color, int x1, int y1, int x2, int y2);
+    void (*draw_polyline)(void *context, int color, PlotPoint *points, int count);
+    void (*draw_text)(void *context, int color, int x, int y, const char *text);
+    // Optional: draw the history of one data field straight from the device, placing it like transform_points() would
+    // NULL makes the core transform and decimate the history itself and draw it with draw_polyline
+    void (*draw_series)(void *context, int color, SerialDevice *device, int field, double x_latest, double x_per_us, int bottom, float min_value, float y_factor);
+    // Copy an XRGB8888 image with rows of width pixels into the window, used by the raster based modes
+    void (*draw_image)(void *context, int x, int y, int width, int height, const uint32_t *pixels);
+    // Optional: show the static layer (background, grid and labels), drawn by draw(renderer) into an off-screen copy kept
+    // by the backend when rebuild is set or the copy is missing, then copied into the frame
+    // NULL makes the core draw the static layer into every frame
+    void (*static_layer)(void *context, int rebuild, void (*draw)(PlotRenderer *renderer));
+    // Optional: draw the lines between consecutive points like draw_polyline, but every point after the first is relative
+    // to the previous one. NULL makes the core transform and decimate the whole history of every data field for every frame
+    void (*draw_polyline_relative)(void *context, int color, PlotPoint *points, int count);
+};
+
+// The source backends, a device name without a known prefix is a serial port
+extern const SourceBackend source_backends[];
+// The red, green and blue of every palette color from 0 to 1, for backends that do not allocate colors by name like Xlib
+extern const float palette_rgb[COLORS][3];
+
+extern struct timespec start_time; // CLOCK_MONOTONIC time the program started at
+extern SerialDevice devices[MAX_DEVICES]; // The devices plotted by this process
+extern int num_devices; // Number of devices
+extern Graph graph; // Graph parameters
+extern uint8_t color_theme; // Color theme, 1 is dark
+extern int merged_view; // Whether all devices are drawn into one merged view instead of one pane per device
+extern int show_stats; // Whether the ingest statistics overlay is drawn
+extern int show_perf; // Whether the stages are timed and the performance overlay is drawn
+extern int baud_rate; // Baud rate of the serial ports
+extern int low_latency; // Whether the low latency mode of the serial drivers is requested
+extern int tracing; // Whether the trace probes record events
+extern PerfStage perf_stages[PERF_STAGES]; // Latest timings of each stage
+extern int64_t perf_transform_time; // Transform time of the panes of the current frame, in nanoseconds
+extern unsigned long perf_requests; // Requests the render backend issued for the latest frame
+extern float perf_samples_per_frame; // Data points received between the latest two frames
+extern PlotPoint points[PLOT_POINTS]; // Window coordinates of one data field while it is drawn
+extern double autoscale_hysteresis; // Seconds the data has to fit into a smaller range before a pane shrinks to it
+extern int64_t window_span; // Fixed time span of the x-axis in microseconds, 0 shows whatever span the histories cover
+extern int64_t bucket_span; // Duration of one bucket of the fixed time window, in microseconds
+extern int xy_mode; // Whether every pane plots one data field against another instead of against time
+extern int xy_fields[2]; // Data fields on the x and the y axis of the XY mode
+extern int xy_samples; // Latest data points the XY mode plots again when it starts over
+extern Raster raster; // Persistence image of the raster based modes
+extern RasterLine raster_lines[MAX_DEVICES * MAX_DATA_POINTS]; // Lines of the XY mode laid out by the latest frame
+extern int defer_raster; // Whether the front end calls render_raster() itself after the layout, otherwise the layout does
+extern int density_mode; // Whether every pane shows how often the samples of all data fields hit each pixel of a sweep
+extern int64_t density_sweep; // Duration of one sweep of the density mode across the pane, in microseconds
+extern int scope_mode; // Whether every pane shows the latest window captured around a trigger instead of the rolling history
+extern ScopeTrigger scope_trigger; // Trigger settings of the scope mode
+extern ScopeState scope_states[MAX_DEVICES]; // Trigger state and latest capture of every device
+// Called for every data point accepted into a history, with its raw timestamp counter and host receive time, NULL for none
+extern void (*data_point_hook)(SerialDevice *device, uint32_t counter, double host_time);
+
+// timing and tracing
+int64_t perf_now();
+double host_time_ms();
+void perf_record(int stage, int64_t duration);
+int perf_percentiles(PerfStage *perf, double *p50, double *p99);
+void print_perf_stats(FILE *file);
+void init_trace_ring(TraceRing *ring, int tid);
+int64_t trace_begin();
+void trace_end(TraceRing *ring, int name, int64_t begin);
+int write_trace_ring(FILE *file, TraceRing *ring, int64_t origin, int first);
+
+// clock model
+double clock_model_host(ClockModel *model, double device_time);
+double clock_model_device(ClockModel *model, double host_time);
+double clock_model_drift_ppm(ClockModel *model);
+double clock_model_jitter(ClockModel *model);
+void update_clock_model(ClockModel *model, double device_time, double host_time);
+
+// sources and ingest
+void init_device(SerialDevice *device, char *name, int num_fields, uint16_t timestamp_unit);
+void parse_device(SerialDevice *device, char *name, char *format);
+void open_source(SerialDevice *device);
+void close_source(SerialDevice *device);
+int parse_data_point(SerialDevice *device, char *line, int index, uint32_t *counter, DataPoint *data_point);
+void log_ingest_error(SerialDevice *device, double host_time, const char *reason, const char *line);
+void read_driver_counters(SerialDevice *device, double host_time);
+uint32_t rejected_lines(IngestStats *stats);
+void format_ingest_stats(SerialDevice *device, char text[3][160]);
+void print_ingest_stats(FILE *file);
+int64_t unwrap_timestamp(SerialDevice *device, uint32_t counter);
+void append_data_point(SerialDevice *device, int64_t timestamp, DataPoint *data_point);
+void ingest_line(SerialDevice *device, char *line, int length, double host_time);
+void frame_chunk(SerialDevice *device, char *chunk, int n, double host_time);
+void parse_xy_mode(char *arg);
+void parse_density_mode(char *arg);
+void bin_data_point(SerialDevice *device, int64_t timestamp, DataPoint *data_point);
+
+// autoscale, decimation and drawing
+void update_graph();
+void parse_window_span(char *arg);
+void bucket_data_point(SerialDevice *device, int64_t timestamp, DataPoint *data_point);
+void bucket_value_range(SerialDevice *device, float *min_value, float *max_value);
+double nice_step(double range);
+int autoscale(SerialDevice *device, float data_min, float data_max, double now);
+int transform_buckets(SerialDevice *device, int field, double x_latest, double x_per_us, int bottom, float min_value, float y_factor);
+int transform_points(SerialDevice *device, int field, double x_latest, double x_per_us, int bottom, float min_value, float y_factor);
+void update_vertex_cache(SerialDevice *device, int field, double x_per_us, int bottom, float min_value, float y_factor);
+int draw_cached_series(PlotRenderer *renderer, int color, SerialDevice *device, int field, double x_latest);
+void pane_value_range(SerialDevice *pane_devices, int count, float *min_value, float *max_value);
+void draw_pane_grid(PlotRenderer *renderer, SerialDevice *pane_devices, int count, int top, int height);
+void draw_static_layer(PlotRenderer *renderer);
+int static_layer_changed();
+void draw_pane(PlotRenderer *renderer, SerialDevice *pane_devices, int count, int top, int height);
+void resize_raster(Raster *raster, int width, int height);
+void fade_raster(Raster *raster, float factor);
+v4sf log2_approx(v4sf x);
+float max_intensity(Raster *raster);
+void draw_raster_line(Raster *raster, int x0, int y0, int x1, int y1, float intensity, int color);
+void present_raster(Raster *raster, int background);
+void add_hits(Raster *raster);
+void render_raster();
+void draw_xy_frame(PlotRenderer *renderer);
+void present_density(Raster *raster, int background);
+void set_density_plot(SerialDevice *device, DensityPlot *plot, int left, int top, int width, int height);
+void draw_density_frame(PlotRenderer *renderer);
+int raster_animating();
+void parse_scope_mode(char *arg);
+void capture_window(SerialDevice *device, ScopeState *scope);
+void check_trigger(SerialDevice *device, int64_t timestamp, DataPoint *data_point);
+int new_capture();
+void draw_scope_pane(PlotRenderer *renderer, int first, int count, int top, int height);
+void draw_scope_frame(PlotRenderer *renderer);
+void draw_frame(PlotRenderer *renderer);
+void draw_perf_overlay(PlotRenderer *renderer);
+
+#endif // PLOTTER_CORE_H
@@ -22,6 +22,8 @@
 
 #include <unistd.h>
 
+#include <fcntl.h>
+
 #include <X11/Xlib.h>
 
 #include <X11/Xutil.h>
@@ -0,0 +1,256 @@
+// A stand-in for a serial device: creates a pseudo terminal and writes CSV data points into it, so the plotters can be run and measured without hardware.
+// The data points have the same format as example.ino sends: timestamp first, then the data values.
+// The timestamp is taken from CLOCK_MONOTONIC, so a reader on the same host can compute how old each data point is.
+// The output can be paced to the byte rate of a real UART (10 bits per byte) or to a fixed line rate.
+// Instead of sine waves a recorded data set can be replayed in a loop, its timestamps are replaced by the send time.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+#define MAX_DATA_FIELDS 8 // Maximum number of data fields to generate
+#define LINE_SIZE 256 // max line size (line buffer)
+#define WRITE_CHUNK 4096 // how many bytes are written into the pseudo terminal at once
+#define PACING_INTERVAL 1000000 // nanoseconds of output written per paced chunk when pacing to a baud rate
+#define STALL_TIMEOUT 5000 // milliseconds a write may make no progress before the reader is considered gone
+
+// A global variable to store the pseudo terminal master file descriptor
+int master_fd;
+// A global variable to store our own descriptor of the slave side, it keeps the data written before the reader opens it
+int slave_fd;
+// A global variable to stop the generator on SIGINT/SIGTERM
+volatile sig_atomic_t stop = 0;
+// A global variable to store the data values of the recorded lines, each starting with the comma after the timestamp
+char **recorded_lines = NULL;
+// A global variable to store the number of recorded lines
+int num_recorded_lines = 0;
+
+// A function to return the CLOCK_MONOTONIC time in nanoseconds
+int64_t monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// A function to sleep until the given CLOCK_MONOTONIC time in nanoseconds
+void sleep_until(int64_t deadline) {
+    struct timespec until = { deadline / 1000000000, deadline % 1000000000 };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR && !stop) {
+    }
+}
+
+// A function to handle SIGINT/SIGTERM
+void handle_signal(int signal) {
+    stop = 1;
+}
+
+// A function to open the pseudo terminal and return the name of its slave side
+char *open_pty() {
+    master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (master_fd == -1 || grantpt(master_fd) == -1 || unlockpt(master_fd) == -1) {
+        fprintf(stderr, "Error: Cannot open a pseudo terminal\n");
+        exit(1);
+    }
+    char *slave_name = ptsname(master_fd);
+    // the slave side starts in raw mode, so nothing is echoed or buffered in lines before the reader sets it up
+    slave_fd = open(slave_name, O_RDONLY | O_NOCTTY);
+    struct termios options;
+    if (slave_fd == -1 || tcgetattr(slave_fd, &options) == -1) {
+        fprintf(stderr, "Error: Cannot open %s\n", slave_name);
+        exit(1);
+    }
+    cfmakeraw(&options);
+    tcsetattr(slave_fd, TCSANOW, &options);
+    return slave_name;
+}
+
+// A function to load a recorded data set, one data point per line with the timestamp first
+// Lines without data values after the timestamp, or too long to fit a new timestamp into LINE_SIZE, are skipped
+void load_recording(char *file_name) {
+    FILE *file = fopen(file_name, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot open %s\n", file_name);
+        exit(1);
+    }
+    char line[LINE_SIZE];
+    int capacity = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *values = strchr(line, ',');
+        if (values == NULL || strlen(values) > LINE_SIZE - 16) {
+            continue;
+        }
+        if (num_recorded_lines == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            recorded_lines = realloc(recorded_lines, capacity * sizeof(char *));
+        }
+        recorded_lines[num_recorded_lines++] = strdup(values);
+    }
+    fclose(file);
+    if (num_recorded_lines == 0) {
+        fprintf(stderr, "Error: No data points in %s\n", file_name);
+        exit(1);
+    }
+}
+
+// A function to write a whole buffer into the pseudo terminal
+// Return 0 if successful, -1 if the reader went away or stopped reading
+int write_all(char *buffer, int length) {
+    while (length > 0 && !stop) {
+        int n = write(master_fd, buffer, length);
+        if (n == -1) {
+            if (errno == EAGAIN) {
+                // the pseudo terminal buffer is full, wait for the reader
+                struct pollfd pollfd = { master_fd, POLLOUT, 0 };
+                if (poll(&pollfd, 1, STALL_TIMEOUT) == 0) {
+                    fprintf(stderr, "Error: The reader stopped reading\n");
+                    return -1;
+                }
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buffer += n;
+        length -= n;
+    }
+    return stop ? -1 : 0;
+}
+
+// A function to format one data point of num_fields sine waves with different frequencies, or the next recorded one
+// Return the length of the line
+int format_line(char *line, int64_t now, uint64_t index, int num_fields, int micros) {
+    uint32_t timestamp = micros ? (uint32_t) (now / 1000) : (uint32_t) (now / 1000000);
+    if (num_recorded_lines > 0) {
+        return sprintf(line, "%u%s\n", timestamp, recorded_lines[index % num_recorded_lines]);
+    }
+    int length = sprintf(line, "%u", timestamp);
+    for (int i = 0; i < num_fields; i++) {
+        length += sprintf(line + length, ",%.3f", 100.0 * sin(index * 0.01 * (i + 1)) + i * 10);
+    }
+    line[length++] = '\n';
+    return length;
+}
+
+// A function to print the command line usage and exit
+void usage(char *program) {
+    fprintf(stderr, "Usage: %s [-b <baud rate>] [-r <lines per second>] [-f <number of data fields>] [-n <number of lines>] [-u] [-s <symlink>] [-i <recorded data>]\n", program);
+    fprintf(stderr, "       -b paces the output to the byte rate of a UART at that baud rate (10 bits per byte)\n");
+    fprintf(stderr, "       -r paces the output to a fixed number of lines per second, without -b and -r it is written as fast as it is read\n");
+    fprintf(stderr, "       -u sends micros() instead of millis() timestamps\n");
+    fprintf(stderr, "       -s creates a symlink to the pseudo terminal, e.g. /tmp/ttyFAKE0\n");
+    fprintf(stderr, "       -i replays the data values of a recorded CSV file in a loop instead of sine waves\n");
+    exit(1);
+}
+
+// The main function of the program
+int main(int argc, char **argv) {
+    int baud = 0;
+    double line_rate = 0;
+    int num_fields = 4;
+    uint64_t max_lines = 0;
+    int micros = 0;
+    char *symlink_name = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "b:r:f:n:us:i:")) != -1) {
+        switch (option) {
+            case 'b': baud = atoi(optarg); break;
+            case 'r': line_rate = atof(optarg); break;
+            case 'f': num_fields = atoi(optarg); break;
+            case 'n': max_lines = strtoull(optarg, NULL, 10); break;
+            case 'u': micros = 1; break;
+            case 's': symlink_name = optarg; break;
+            case 'i': load_recording(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (num_fields < 1 || num_fields > MAX_DATA_FIELDS || baud < 0 || line_rate < 0) {
+        usage(argv[0]);
+    }
+
+    char *slave_name = open_pty();
+    if (symlink_name != NULL) {
+        unlink(symlink_name);
+        if (symlink(slave_name, symlink_name) == -1) {
+            fprintf(stderr, "Error: Cannot create symlink %s\n", symlink_name);
+            exit(1);
+        }
+    }
+    // the reader needs the slave name, print it first and alone on its line
+    printf("%s\n", slave_name);
+    fflush(stdout);
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    char chunk[WRITE_CHUNK + LINE_SIZE];
+    int chunk_length = 0;
+    uint64_t lines = 0;
+    uint64_t bytes = 0;
+    int64_t start = monotonic_ns();
+    int64_t next_write = start;
+    // nanoseconds one byte takes on the wire at the given baud rate
+    double byte_time = baud > 0 ? 10.0e9 / baud : 0;
+
+    while (!stop && (max_lines == 0 || lines < max_lines)) {
+        int chunk_lines = 0;
+        if (line_rate > 0) {
+            // one line per period, each written on its own so its timestamp is its send time
+            sleep_until(start + (int64_t) (lines * 1e9 / line_rate));
+            chunk_length = format_line(chunk, monotonic_ns(), lines, num_fields, micros);
+            chunk_lines = 1;
+        } else {
+            // fill a chunk of lines, paced to the UART byte rate if there is one
+            if (baud > 0) {
+                sleep_until(next_write);
+            }
+            int chunk_limit = baud > 0 ? (int) (PACING_INTERVAL / byte_time) + 1 : WRITE_CHUNK;
+            if (chunk_limit > WRITE_CHUNK) {
+                chunk_limit = WRITE_CHUNK;
+            }
+            int64_t now = monotonic_ns();
+            chunk_length = 0;
+            while (chunk_length < chunk_limit && (max_lines == 0 || lines + chunk_lines < max_lines)) {
+                chunk_length += format_line(chunk + chunk_length, now, lines + chunk_lines, num_fields, micros);
+                chunk_lines++;
+            }
+            next_write += (int64_t) (chunk_length * byte_time);
+        }
+        if (write_all(chunk, chunk_length) == -1) {
+            break;
+        }
+        lines += chunk_lines;
+        bytes += chunk_length;
+    }
+
+    // wait until the reader consumed everything, closing the master hangs up the slave and drops unread data
+    int pending;
+    int64_t deadline = monotonic_ns() + (int64_t) STALL_TIMEOUT * 1000000;
+    while (!stop && ioctl(slave_fd, FIONREAD, &pending) == 0 && pending > 0 && monotonic_ns() < deadline) {
+        usleep(1000);
+    }
+
+    double elapsed = (monotonic_ns() - start) / 1e9;
+    fprintf(stderr, "%llu lines, %llu bytes in %.3f s: %.0f lines/s, %.0f bytes/s\n",
+            (unsigned long long) lines, (unsigned long long) bytes, elapsed, lines / elapsed, bytes / elapsed);
+    if (symlink_name != NULL) {
+        unlink(symlink_name);
+    }
+    close(slave_fd);
+    close(master_fd);
+    return 0;
+}
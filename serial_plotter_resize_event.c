@@ -2,102 +2,295 @@
 
 // A simple X11 program for Linux written in C plotting real-time rolling graph and updating it using data from serial port specified at command line.
 // Assume serial port data is in CSV format, with first field representing timestamp in milliseconds, and following fields represent data values.
+// The timestamp is a free running 32 bit counter (millis() or micros()), it is unwrapped into a 64 bit microsecond timeline.
 // Plot each data field in different color and support up to 8 data fields containing float values.
 // Implement ability to resize the window.
+// Several serial devices can be plotted by one process, either in stacked panes or merged into one view.
+// The ingest, history, autoscaling and layout are the plotter core (plotter_core.c), this file is its Xlib and libev front end.
+// With -g the frames are drawn with OpenGL (gl_renderer.c) into the same window instead of with Xlib requests.
+// The main thread reads the devices and the window events, the frames are drawn by a render thread on its own X connection,
+// so a slow X server never holds up the serial reads. Both share the plotter core under one lock, the render thread only
+// holds it to lay out a frame into a recorded list of primitives, and draws the list without it.
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdint.h>
-#include <termios.h>
-#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/syscall.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <ev.h>
+#include "plotter_core.h"
+#include "gl_renderer.h"
 //#include <readline.h>
 
-#define BAUD_RATE B115200
-
-#define MAX_DATA_FIELDS 8 // Maximum number of data fields to plot
 #define WINDOW_WIDTH 800 // Initial window width
 #define WINDOW_HEIGHT 600 // Initial window height
 //#define DATA_POINT_CIRCLE // wheter to draw a circle on each data point position (slow)
-#define MARGIN 20 // Margin around the graph
-#define INTERNAL_GRAPH_MARGIN 0.001 // Margin for min/max values
-
-#define COLOR_BLACK 0 // Color index for black
-#define COLOR_RED 1 // Color index for red
-#define COLOR_GREEN 2 // Color index for green
-#define COLOR_BLUE 3 // Color index for blue
-#define COLOR_YELLOW 4 // Color index for yellow
-#define COLOR_MAGENTA 5 // Color index for magenta
-#define COLOR_CYAN 6 // Color index for cyan
-#define COLOR_GRAY 7 // Color index for white
-#define COLOR_WHITE 8 // Color index for white
-
-// A structure to store a data point
-typedef struct {
-    uint32_t timestamp; // Timestamp in milliseconds
-    float values[MAX_DATA_FIELDS]; // Data values
-} DataPoint;
-
-#define MAX_DATA_POINTS 2048 // Maximum number of data points to store 
-#define DISCARD_DATA_POINTS 3 // amount of data points to discard to synchronize with source
-#define LINE_SIZE 256 // max line size (line buffer)
-#define SERIAL_DATA_NO_DATA_SLEEP 50 // in udelay(<value>) how long should serial input routine sleep in case data comes slower than we read it
-#define SERIAL_TIMEOUT_FOR_IMPARTIAL_DATA 32768 // uint16_t , how many times we should sleep until giving up and avoiding being stuck in the serial read routine forever
 
-// A structure to store the graph parameters
-typedef struct {
-    uint16_t width; // Window width
-    uint16_t height; // Window height
-    uint8_t num_fields; // Number of data fields to plot
-    uint32_t min_timestamp; // Minimum timestamp in the data
-    uint32_t max_timestamp; // Maximum timestamp in the data
-    float min_value; // Minimum value in the data
-    float max_value; // Maximum value in the data
-    int colors[MAX_DATA_FIELDS]; // Colors for each data field
-} Graph;
-
-// A global variable to store the display pointer
+#define FRAME_INTERVAL (1.0 / 60) // seconds between redraws while new data keeps arriving
+#define STATS_INTERVAL 1.0 // seconds over which the per-device line rate is averaged
+#define LATENCY_SAMPLES (1 << 20) // data point latencies recorded by the latency mode, later ones are only counted
+#define LATENCY_PENDING 65536 // data points received but not drawn yet that the latency mode can track
+#define FRAME_COMMANDS 65536 // drawing primitives one recorded frame can hold
+#define FRAME_POINTS (MAX_DEVICES * MAX_DATA_FIELDS * PLOT_POINTS) // polyline points one recorded frame can hold
+#define FRAME_TEXT 65536 // bytes of text one recorded frame can hold
+
+// A global variable to store the display connection of the main thread, it creates the window and receives its events
+Display *event_display;
+// A global variable to store the display connection of the render thread, all drawing goes through it
 Display *display;
 // A global variable to store the window ID
 Window window;
+// A global variable to store the drawable the Xlib backend draws into, the window or the static layer pixmap while it is drawn
+Drawable target;
+// A global variable to store the pixmap holding the static layer of the Xlib backend, None until the first frame
+Pixmap static_pixmap = None;
+// a global variable to store the size of the static layer pixmap
+int static_width = 0, static_height = 0;
 // A global variable to store the graphics context
 GC gc;
 // A global variable to store the color map
 Colormap colormap;
 // A global variable to store the color pixels
-unsigned long pixels[9]; // 9 because 9 colors in the palette. 
-// A global variable to store the serial port file descriptor
-int serial_fd;
-// A global variable to store the data buffer
-DataPoint buffer[MAX_DATA_POINTS];
-// A global variable to store the number of data points in the buffer
-int buffer_size;
-// A global variable to store the graph parameters
-Graph graph;
+unsigned long pixels[COLORS]; // 9 because 9 colors in the palette.
+// A global variable to store the renderer the frames are laid out with, the frame recorder
+PlotRenderer *renderer;
+// A global variable to store the render backend the recorded frames are drawn with, the Xlib or the OpenGL one
+PlotRenderer *backend;
+// a global variable to indicate the OpenGL render backend is used
+Bool gl_mode = False;
+// A global variable to store the visual of the OpenGL window, chosen by the main thread and used by the render thread
+XVisualInfo *gl_visual = NULL;
+// A global variable to store the render thread
+pthread_t render_thread;
+// A global variable to store the thread opening the devices while the main thread connects to the X server
+pthread_t open_thread;
+// A global variable to store the lock of the plotter core, held by the main thread while it ingests data or handles an event
+// and by the render thread while it lays out a frame, never while either waits for the X server
+// The render thread is the only one changing graph, so it reads it without the lock while it draws
+pthread_mutex_t core_lock = PTHREAD_MUTEX_INITIALIZER;
+// A global variable to store the condition the render thread waits on between frames
+pthread_cond_t frame_cond;
+// a global variable to indicate a key, an Expose or the first data point asked for a frame, it is drawn without waiting for the interval
+Bool frame_requested = False;
+// Global variables to store the latest window size, the render thread applies it to graph before the next frame
+int window_width = WINDOW_WIDTH, window_height = WINDOW_HEIGHT;
+// a global variable to store the CLOCK_MONOTONIC_RAW time the render thread started laying out the current frame
+int64_t frame_locked = 0;
+// a global variable to keep the render thread running, cleared on exit
+Bool render_running = True;
+// A global variable to store the libev io watchers of the device file descriptors
+ev_io watchers[MAX_DEVICES];
 // a global variable to store keypress event
-Bool keypress = False; 
+Bool keypress = False;
+// a global variable to indicate t was pressed, the trace is written once the events were handled
+Bool trace_requested = False;
 // A function to initialize the X11 display and window
-Bool new_serial_data = False; 
+Bool new_serial_data = False;
 // a global variable to indicate new serial data arrived
-uint8_t color_theme = 0; 
-// a global variable to store color theme
+double serial_ready_time = -1;
+// a global variable to store when all serial ports were open, in milliseconds since start
+double x11_ready_time = -1;
+// a global variable to store when the X11 window was created, in milliseconds since start
+double first_sample_time = -1;
+// a global variable to store when the first valid data point was received, in milliseconds since start
+double first_pixel_time = -1;
+// a global variable to store when the X server had drawn the first data point, in milliseconds since start
+Bool window_exposed = False;
+// a global variable to indicate the window is mapped and drawing into it is visible
+int64_t perf_last_frame = 0;
+// a global variable to store the CLOCK_MONOTONIC_RAW time of the latest frame, 0 before the first timed frame
+uint32_t perf_lines_at_last_frame = 0;
+// a global variable to store the number of data points received by all devices at the latest frame
+int latency_mode = 0;
+// a global variable to select the latency mode, 1 measures receive to present, 2 also send to present of marker timestamps
+float *receive_latencies = NULL;
+// a global variable to store the receive to present latencies of the data points, in microseconds
+float *marker_latencies = NULL;
+// a global variable to store the send to present latencies of the marker timestamps, in microseconds
+int num_latencies = 0;
+// a global variable to store the number of recorded latencies
+uint32_t unrecorded_latencies = 0;
+// a global variable to count the data points that were drawn but did not fit into the latency arrays
+double pending_receive_times[LATENCY_PENDING];
+// a global variable to store the host receive times of the data points not drawn yet
+uint32_t pending_markers[LATENCY_PENDING];
+// a global variable to store the raw device timestamps of the data points not drawn yet
+int num_pending = 0;
+// a global variable to store the number of data points not drawn yet
+double frame_receive_times[LATENCY_PENDING];
+// a global variable to store the host receive times of the data points in the frame being drawn
+uint32_t frame_markers[LATENCY_PENDING];
+// a global variable to store the raw device timestamps of the data points in the frame being drawn
+int frame_num_pending = 0;
+// a global variable to store the number of data points in the frame being drawn
+char *trace_file = NULL;
+// a global variable to store the file the trace is written to, NULL if tracing is off
+TraceRing main_trace;
+// a global variable to store the trace ring of the main thread, the read, parse and append events
+TraceRing render_trace;
+// a global variable to store the trace ring of the render thread, the autoscale, render and X flush events
+
+// A function to return the begin time of the oldest event of a trace ring, 0 if it is empty
+int64_t oldest_trace_event(TraceRing *ring) {
+    if (ring->next == 0) {
+        return 0;
+    }
+    return ring->events[(ring->next < TRACE_EVENTS) ? 0 : ring->next & (TRACE_EVENTS - 1)].begin;
+}
+
+// A function to dump the trace rings to the trace file as Chrome trace JSON, readable by chrome://tracing and Perfetto
+// The render thread keeps recording meanwhile, at worst the newest event of its ring is torn
+void dump_trace() {
+    FILE *file = fopen(trace_file, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot write the trace to %s\n", trace_file);
+        return;
+    }
+    // the timestamps start at the oldest event of both rings
+    int64_t origin = oldest_trace_event(&main_trace);
+    if (origin == 0 || (render_trace.next > 0 && oldest_trace_event(&render_trace) < origin)) {
+        origin = oldest_trace_event(&render_trace);
+    }
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    fprintf(file, "\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"main\"}}", main_trace.tid);
+    fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"render\"}}", render_trace.tid);
+    int count = write_trace_ring(file, &main_trace, origin, False);
+    count += write_trace_ring(file, &render_trace, origin, False);
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    fprintf(stderr, "Trace: %d events written to %s\n", count, trace_file);
+}
+
+// A function to wait until the frame just drawn is in the frame buffer, the X server executed it or OpenGL finished it
+void sync_frame() {
+    if (gl_mode) {
+        gl_finish();
+    } else {
+        XSync(display, False);
+    }
+}
 
-DataPoint data_point;
-// a global structure for data point
+// A function to wait until the X server executed the frame just drawn and record the latency of the data points in it
+// XSync returns once the drawing is in the frame buffer, the compositor and the next vertical blank may still add up to a frame
+// Only the render thread calls it, without the lock, the data points of the frame were copied out of the pending ones
+void present_frame() {
+    int64_t trace = trace_begin();
+    sync_frame();
+    trace_end(&render_trace, TRACE_FLUSH, trace);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double present_time = host_time_ms();
+    // marker timestamps are the CLOCK_MONOTONIC microseconds they were sent at, truncated to 32 bits
+    uint32_t present_marker = (uint32_t) ((uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000);
+    for (int i = 0; i < frame_num_pending; i++) {
+        if (num_latencies == LATENCY_SAMPLES) {
+            unrecorded_latencies += frame_num_pending - i;
+            break;
+        }
+        receive_latencies[num_latencies] = (present_time - frame_receive_times[i]) * 1000.0;
+        marker_latencies[num_latencies] = (float) (int32_t) (present_marker - frame_markers[i]);
+        num_latencies++;
+    }
+    frame_num_pending = 0;
+}
 
+// A function to compare two latencies for qsort
+int compare_latencies(const void *a, const void *b) {
+    float x = *(const float *) a;
+    float y = *(const float *) b;
+    return (x > y) - (x < y);
+}
+
+// A function to print the min/p50/p99/max of some latencies, the array is sorted in place
+void print_latency_distribution(FILE *file, const char *name, float *latencies, int n) {
+    qsort(latencies, n, sizeof(float), compare_latencies);
+    fprintf(file, "latency %s: %d data points, min %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", name, n,
+            latencies[0] / 1000.0, latencies[n / 2] / 1000.0, latencies[n * 99 / 100] / 1000.0, latencies[n - 1] / 1000.0);
+}
+
+// A function to print the latency distributions of the latency mode
+void print_latency_stats(FILE *file) {
+    if (num_latencies == 0) {
+        fprintf(file, "latency: no data point was drawn\n");
+        return;
+    }
+    print_latency_distribution(file, "receive to present", receive_latencies, num_latencies);
+    if (latency_mode == 2) {
+        print_latency_distribution(file, "send to present", marker_latencies, num_latencies);
+    }
+    if (unrecorded_latencies > 0) {
+        fprintf(file, "latency: %u more data points drawn but not recorded\n", unrecorded_latencies);
+    }
+}
+
+// A function to open the display connection of the main thread and create the window, its events are read by the main thread
 void init_x11(char *title) {
     // Open the display connection
+    event_display = XOpenDisplay(NULL);
+    if (event_display == NULL) {
+        fprintf(stderr, "Error: Cannot open display\n");
+        exit(1);
+    }
+    // Get the default screen and root window ID
+    int screen = DefaultScreen(event_display);
+    Window root = RootWindow(event_display, screen);
+
+    // Create the window with some attributes
+    if (gl_mode) {
+        // OpenGL draws into the window through GLX, the window needs a visual with a double buffered GL configuration
+        gl_visual = gl_choose_visual(event_display, screen);
+        XSetWindowAttributes attributes;
+        attributes.colormap = XCreateColormap(event_display, root, gl_visual->visual, AllocNone);
+        attributes.border_pixel = BlackPixel(event_display, screen);
+        window = XCreateWindow(event_display, root, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, 1, gl_visual->depth, InputOutput,
+                               gl_visual->visual, CWColormap | CWBorderPixel, &attributes);
+    } else {
+        window = XCreateSimpleWindow(event_display, root,
+                                     0, 0,
+                                     WINDOW_WIDTH, WINDOW_HEIGHT,
+                                     1,
+                                     BlackPixel(event_display, screen),
+                                     WhitePixel(event_display, screen));
+    }
+
+    // Set the window title and icon name
+    XStoreName(event_display, window, title);
+    XSetIconName(event_display, window, title);
+
+    // Select some events to handle
+    XSelectInput(event_display, window,
+                 ExposureMask | KeyPressMask | StructureNotifyMask);
+
+    // Assign different colors to each data field
+    graph.colors[0] = COLOR_RED;
+    graph.colors[1] = COLOR_GREEN;
+    graph.colors[2] = COLOR_BLUE;
+    graph.colors[3] = COLOR_YELLOW;
+    graph.colors[4] = COLOR_MAGENTA;
+    graph.colors[5] = COLOR_CYAN;
+    graph.colors[6] = COLOR_BLACK;
+    graph.colors[7] = COLOR_GRAY;
+
+    // Map the window on the screen and flush the output buffer
+    XMapWindow(event_display, window);
+    XFlush(event_display);
+}
+
+// A function to open the display connection of the render thread, with the colors, the graphics context and the OpenGL context
+// The window belongs to the connection of the main thread, X resources are shared by all connections to the server
+void init_render_connection() {
     display = XOpenDisplay(NULL);
     if (display == NULL) {
         fprintf(stderr, "Error: Cannot open display\n");
         exit(1);
     }
-    // Get the default screen and root window ID
     int screen = DefaultScreen(display);
-    Window root = RootWindow(display, screen);
     // Get the default color map and allocate some colors
     colormap = DefaultColormap(display, screen);
     XColor color;
@@ -120,320 +313,489 @@ void init_x11(char *title) {
     XAllocNamedColor(display, colormap, "white", &color, &color);
     pixels[COLOR_WHITE] = color.pixel;
 
-    // Create the window with some attributes
-
-    window = XCreateSimpleWindow(display, root,
-                                 0, 0,
-                                 WINDOW_WIDTH, WINDOW_HEIGHT,
-                                 1,
-                                 pixels[COLOR_BLACK],
-                                 pixels[COLOR_WHITE]);
-
-    // Set the window title and icon name
-    XStoreName(display, window, title);
-    XSetIconName(display, window, title);
-
-    // Select some events to handle
-    XSelectInput(display, window,
-                 ExposureMask | KeyPressMask | StructureNotifyMask);
-    // Create a graphics context with some attributes
     XGCValues values; // Create a XGCValues structure
     values.foreground = pixels[COLOR_BLACK]; // Set the foreground color to black
     values.background = pixels[COLOR_WHITE]; // Set the background color to white
     // Create a graphics context with some attributes
     gc = XCreateGC(display, window,
                    GCForeground | GCBackground, // Specify which attributes are set
-                   &values); // Pass the pointer to the XGCValues structure 
+                   &values); // Pass the pointer to the XGCValues structure
 
     XSetForeground(display, gc,
                    pixels[COLOR_BLACK]);
 
     XSetBackground(display, gc,
                    pixels[COLOR_WHITE]);
-
-    // Assign different colors to each data field
-    graph.colors[0] = COLOR_RED;
-    graph.colors[1] = COLOR_GREEN;
-    graph.colors[2] = COLOR_BLUE;
-    graph.colors[3] = COLOR_YELLOW;
-    graph.colors[4] = COLOR_MAGENTA;
-    graph.colors[5] = COLOR_CYAN;
-    graph.colors[6] = COLOR_BLACK;
-    graph.colors[7] = COLOR_GRAY;
-
-    // Map the window on the screen and flush the output buffer
-    XMapWindow(display, window);
-    XFlush(display);
+    // copying the static layer from its pixmap must not generate a NoExpose event per frame
+    XSetGraphicsExposures(display, gc, False);
+    target = window;
+
+    if (gl_mode) {
+        // the OpenGL context is current in the thread that created it, the render thread
+        gl_init(display, window, gl_visual);
+        XFree(gl_visual);
+    }
 }
 
-// A function to close the X11 display and window
+// A function to close the display connection of the render thread
 
-void close_x11() {
+void close_render_connection() {
+    if (gl_mode) {
+        gl_close();
+    }
+    if (static_pixmap != None) {
+        XFreePixmap(display, static_pixmap);
+    }
     // Free the graphics context and the color pixels
     XFreeGC(display, gc);
     XFreeColors(display, colormap, pixels, 8, 0);
+    XCloseDisplay(display);
+}
+
+// A function to close the X11 display and window
 
+void close_x11() {
     // Destroy the window and close the display connection
-    XDestroyWindow(display, window);
-    XCloseDisplay(display);
+    XDestroyWindow(event_display, window);
+    XCloseDisplay(event_display);
 }
 
 
-// A function to initialize the serial port with the given device name and baud rate
-void init_serial(char *device, int baud) {
+// Xlib primitives the recorded frames are sent with by the render thread, every primitive is one X request
+// XSetForeground only changes the GC cache, Xlib sends the change with the next drawing request if the color differs
 
-    // Open the serial port device file in read-only mode
-//    serial_fd = open(device, O_RDONLY | O_NOCTTY);
-    serial_fd = open(device, O_RDONLY | O_NOCTTY | O_NDELAY);
-    if (serial_fd == -1) {
-        fprintf(stderr, "Error: Cannot open serial port %s\n", device);
-        exit(1);
+// A function to fill a rectangle with a palette color
+void xlib_fill_rectangle(void *context, int color, int x, int y, int width, int height) {
+    XSetForeground(display, gc, pixels[color]);
+    XFillRectangle(display, target, gc, x, y, width, height);
+}
+
+// A function to draw the outline of a rectangle with a palette color
+void xlib_draw_rectangle(void *context, int color, int x, int y, int width, int height) {
+    XSetForeground(display, gc, pixels[color]);
+    XDrawRectangle(display, target, gc, x, y, width, height);
+}
+
+// A function to draw a line with a palette color
+void xlib_draw_line(void *context, int color, int x1, int y1, int x2, int y2) {
+    XSetForeground(display, gc, pixels[color]);
+    XDrawLine(display, target, gc, x1, y1, x2, y2);
+}
+
+// A function to draw the lines between consecutive points with a palette color, as one XDrawLines request
+// PlotPoint is laid out like XPoint, the points are handed to Xlib without a copy
+void xlib_draw_polyline(void *context, int color, PlotPoint *polyline, int count) {
+    // Set the foreground color to the corresponding color for the data field
+    XSetForeground(display, gc, pixels[color]);
+#ifdef DATA_POINT_CIRCLE
+    // Draw a small circle around every data point
+    for (int j = 0; j < count; j++) {
+        XFillArc(display, target, gc,
+                 polyline[j].x - 2, polyline[j].y - 2,
+                 4, 4,
+                 0, 360 * 64);
+    }
+#endif // DATA_POINT_CIRCLE
+    if (count >= 2) {
+        XDrawLines(display, target, gc, (XPoint *) polyline, count, CoordModeOrigin);
     }
+}
 
-    // Get the current terminal attributes of the serial port
-    struct termios options;
-    tcgetattr(serial_fd, &options);
-
-    // Set the input and output baud rate to the given value
-    cfsetispeed(&options, baud);
-    cfsetospeed(&options, baud);
-
-    options.c_cflag |= (CLOCAL | CREAD); // enable local mode and receiver
-    options.c_cflag &= ~PARENB; // disable parity
-    options.c_cflag &= ~CSTOPB; // disable two stop bits
-    options.c_cflag &= ~CSIZE; // mask character size bits
-    options.c_cflag |= CS8; // set 8 data bits
-    options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG); // set raw input mode
-    options.c_iflag &= ~(IXON | IXOFF | IXANY); // disable software flow control
-
-    // Set the terminal attributes of the serial port
-    tcsetattr(serial_fd, TCSANOW, &options);
-}
-
-// A function to close the serial port
-void close_serial() {
-    // Close the serial port device file
-    close(serial_fd);
-}
-
-// A function to read a line from the serial port and parse it as a data point
-// Return 1 if successful, 0 if end of file, -1 if error
-int read_data_point(DataPoint *data_point) {
-    // Initialize a buffer to store the line
-    char line[256];
-    int index = 0;
-    uint16_t timeout_counter = 0; // initalize timeout counter 
-	// this allows serial read loop to exit when just part of data arrived
-	// otherwise it will loop forever waiting for data. 
-
-    // Read characters from the serial port until a newline or end of file is encountered
-//	usleep(10000); // wait for buffer
-    while (1) {
-        // Read one character from the serial port
-        char c;
-        int n = read(serial_fd, &c, 1);
-
-        if (n == 0) { //if no new data
-//            return 0;
-		usleep (SERIAL_DATA_NO_DATA_SLEEP); // wait a little for the buffer to fill up. 
-		if (timeout_counter++ > SERIAL_TIMEOUT_FOR_IMPARTIAL_DATA) { ; // increment timeout counter
-			break;
-        	}
-	// TODO : implement timeout
-        }
+// A function to draw a polyline whose points after the first are relative to the previous one, as one XDrawLines request
+// The server adds up the steps, so the retained polyline of the core is sent as it is
+void xlib_draw_polyline_relative(void *context, int color, PlotPoint *polyline, int count) {
+    XSetForeground(display, gc, pixels[color]);
+#ifdef DATA_POINT_CIRCLE
+    for (int j = 0, x = 0, y = 0; j < count; j++) {
+        x += polyline[j].x;
+        y += polyline[j].y;
+        XFillArc(display, target, gc, x - 2, y - 2, 4, 4, 0, 360 * 64);
+    }
+#endif // DATA_POINT_CIRCLE
+    if (count >= 2) {
+        XDrawLines(display, target, gc, (XPoint *) polyline, count, CoordModePrevious);
+    }
+}
+
+// A function to draw a string with a palette color, y is its baseline
+void xlib_draw_text(void *context, int color, int x, int y, const char *text) {
+    XSetForeground(display, gc, pixels[color]);
+    XDrawString(display, target, gc, x, y, text, strlen(text));
+}
 
-        if (n == -1) {
-            fprintf(stderr, "Error: Cannot read from serial port\n");
-//            return -1;
+// A function to copy an XRGB8888 image into the window, the XImage around the pixels is only made again when they move
+void xlib_draw_image(void *context, int x, int y, int width, int height, const uint32_t *image_pixels) {
+    static XImage *image = NULL;
+    if (image == NULL || image->width != width || image->height != height || image->data != (char *) image_pixels) {
+        if (image != NULL) {
+            // the pixels belong to the caller, XDestroyImage must not free them
+            image->data = NULL;
+            XDestroyImage(image);
         }
-        // Check for newline or buffer overflow
-        if (c == '\n' || index == 255) {
-            break;
+        int screen = DefaultScreen(display);
+        image = XCreateImage(display, DefaultVisual(display, screen), DefaultDepth(display, screen), ZPixmap, 0,
+                             (char *) image_pixels, width, height, 32, width * sizeof(uint32_t));
+    }
+    XPutImage(display, target, gc, image, 0, 0, x, y, width, height);
+}
+
+// A global variable to store the renderer drawing with the Xlib primitives
+PlotRenderer xlib_renderer;
+
+// A function to show the static layer, it is drawn into its pixmap first when it changed or the window size did
+// The copy into the window is one request executed by the server, the labels are not formatted or sent again
+void xlib_static_layer(void *context, int rebuild, void (*draw)(PlotRenderer *renderer)) {
+    if (static_pixmap == None || static_width != graph.width || static_height != graph.height) {
+        if (static_pixmap != None) {
+            XFreePixmap(display, static_pixmap);
         }
-        // Append the character to the buffer
-	if (n == 1 ) { // if there is data
-         line[index++] = c;
-	 timeout_counter = 0 ; // reset the timeout counter
-	}
-    }
-    // Check if the line buffer is empty
-     if (index == 0 ) {
-         return 0 ;
-     }
-    // Check if the line buffer has a trailing CR character and remove it
-     if (line [index - 1] == '\r') {
-         index--;
-     }
-    // Terminate the buffer with a null character
-    line[index] = '\0';
-    // Parse the buffer as a comma-separated list of values
-    char *token ;
-    token = strtok(line, ",");
-    // The first token should be the timestamp in milliseconds
-    if (token == NULL) {
-        fprintf(stderr, "Error: Invalid data format\n");
-        return 0;
+        static_pixmap = XCreatePixmap(display, window, graph.width, graph.height, DefaultDepth(display, DefaultScreen(display)));
+        static_width = graph.width;
+        static_height = graph.height;
+        rebuild = True;
+    }
+    if (rebuild) {
+        target = static_pixmap;
+        draw(&xlib_renderer);
+        target = window;
+    }
+    XCopyArea(display, static_pixmap, window, gc, 0, 0, static_width, static_height, 0, 0);
+}
+
+PlotRenderer xlib_renderer = {NULL, xlib_fill_rectangle, xlib_draw_rectangle, xlib_draw_line, xlib_draw_polyline, xlib_draw_text, NULL, xlib_draw_image, xlib_static_layer, xlib_draw_polyline_relative};
+
+// Drawing commands of a recorded frame
+enum {
+    FRAME_FILL_RECTANGLE,
+    FRAME_DRAW_RECTANGLE,
+    FRAME_DRAW_LINE,
+    FRAME_DRAW_POLYLINE,
+    FRAME_DRAW_POLYLINE_RELATIVE,
+    FRAME_DRAW_TEXT,
+    FRAME_DRAW_IMAGE,
+    FRAME_DRAW_SERIES, // a data field of a device staged by the OpenGL backend, x is the device and y the field
+    FRAME_STATIC_BEGIN, // the static layer follows if it is drawn again, count is 1 then, first is the index of its end
+    FRAME_STATIC_END, // the end of the static layer
+};
+
+// A structure to store one primitive of a recorded frame
+typedef struct {
+    int op; // Drawing command (FRAME_FILL_RECTANGLE...)
+    int color; // Palette color
+    int x, y, width, height; // Position and size, the two end points of a line
+    int first; // Index of the first point in frame_points or of the text in frame_text
+    int count; // Number of points
+    const uint32_t *pixels; // Image of FRAME_DRAW_IMAGE, made by render_raster() before the frame is drawn
+    double x_latest, x_per_us; // Time axis of FRAME_DRAW_SERIES, its bottom is height
+    float min_value, y_factor; // Value axis of FRAME_DRAW_SERIES
+} FrameCommand;
+
+// A global variable to store the primitives of the frame recorded by the render thread
+FrameCommand frame_commands[FRAME_COMMANDS];
+// a global variable to store the number of recorded primitives
+int frame_num_commands = 0;
+// A global variable to store the points of the recorded polylines
+PlotPoint frame_points[FRAME_POINTS];
+// a global variable to store the number of recorded points
+int frame_num_points = 0;
+// A global variable to store the recorded strings, each one terminated
+char frame_text[FRAME_TEXT];
+// a global variable to store the number of bytes of recorded text
+int frame_text_length = 0;
+
+// A function to append a primitive to the recorded frame
+// Return NULL when the frame is full, the primitive is then left out
+FrameCommand *record_command(int op, int color, int x, int y, int width, int height) {
+    if (frame_num_commands == FRAME_COMMANDS) {
+        return NULL;
+    }
+    FrameCommand *command = &frame_commands[frame_num_commands++];
+    command->op = op;
+    command->color = color;
+    command->x = x;
+    command->y = y;
+    command->width = width;
+    command->height = height;
+    command->first = 0;
+    command->count = 0;
+    command->pixels = NULL;
+    return command;
+}
+
+// A function to record the filling of a rectangle
+void record_fill_rectangle(void *context, int color, int x, int y, int width, int height) {
+    record_command(FRAME_FILL_RECTANGLE, color, x, y, width, height);
+}
+
+// A function to record the outline of a rectangle
+void record_draw_rectangle(void *context, int color, int x, int y, int width, int height) {
+    record_command(FRAME_DRAW_RECTANGLE, color, x, y, width, height);
+}
+
+// A function to record a line
+void record_draw_line(void *context, int color, int x1, int y1, int x2, int y2) {
+    record_command(FRAME_DRAW_LINE, color, x1, y1, x2, y2);
+}
+
+// A function to record a polyline, its points are copied because the core reuses them for the next data field
+void record_points(int op, int color, PlotPoint *polyline, int count) {
+    if (count == 0 || frame_num_points + count > FRAME_POINTS) {
+        return;
     }
-    data_point->timestamp = atol(token);
+    FrameCommand *command = record_command(op, color, 0, 0, 0, 0);
+    if (command == NULL) {
+        return;
+    }
+    memcpy(frame_points + frame_num_points, polyline, count * sizeof(PlotPoint));
+    command->first = frame_num_points;
+    command->count = count;
+    frame_num_points += count;
+}
 
-    // The following tokens should be the data values
-        // Get the next token
-        token = strtok(NULL, ",");
-    int i = 0;
+// A function to record the lines between consecutive points
+void record_draw_polyline(void *context, int color, PlotPoint *polyline, int count) {
+    record_points(FRAME_DRAW_POLYLINE, color, polyline, count);
+}
+
+// A function to record a polyline whose points after the first are relative to the previous one
+void record_draw_polyline_relative(void *context, int color, PlotPoint *polyline, int count) {
+    record_points(FRAME_DRAW_POLYLINE_RELATIVE, color, polyline, count);
+}
 
-    while (token != NULL && i < MAX_DATA_FIELDS) {
-        // Convert the token to a float value and store it in the data point
-        data_point->values[i++] = atof(token);
-        // Get the next token
-        token = strtok(NULL, ",");
+// A function to record a string, y is its baseline
+void record_draw_text(void *context, int color, int x, int y, const char *text) {
+    int length = strlen(text) + 1;
+    if (frame_text_length + length > FRAME_TEXT) {
+        return;
+    }
+    FrameCommand *command = record_command(FRAME_DRAW_TEXT, color, x, y, 0, 0);
+    if (command == NULL) {
+        return;
     }
+    memcpy(frame_text + frame_text_length, text, length);
+    command->first = frame_text_length;
+    frame_text_length += length;
+}
 
-    // The number of tokens should match the number of data fields
-    if (token != NULL || i != graph.num_fields) {
-        fprintf(stderr, "Error: Invalid data format\n");
-        return 0;
+// A function to record an XRGB8888 image, the pixels are not copied
+void record_draw_image(void *context, int x, int y, int width, int height, const uint32_t *image_pixels) {
+    FrameCommand *command = record_command(FRAME_DRAW_IMAGE, 0, x, y, width, height);
+    if (command != NULL) {
+        command->pixels = image_pixels;
     }
+}
 
-    // Return success
-    return 1;
-}
-
-// A function to update the graph parameters based on the data buffer
-
-void update_graph() {
-    // Initialize the graph parameters with some default values
-//    graph.width = WINDOW_WIDTH;
-//    graph.height = WINDOW_HEIGHT;
-    graph.min_timestamp = 0;
-    graph.max_timestamp = 1000;
-    graph.min_value = 0;
-    graph.max_value = 1;
-
-//    // Assign different colors to each data field
-//    graph.colors[0] = COLOR_RED;
-//    graph.colors[1] = COLOR_GREEN;
-//    graph.colors[2] = COLOR_BLUE;
-//    graph.colors[3] = COLOR_YELLOW;
-//    graph.colors[4] = COLOR_MAGENTA;
-//    graph.colors[5] = COLOR_CYAN;
-//    graph.colors[6] = COLOR_BLACK;
-//    graph.colors[7] = COLOR_GRAY;
-//  moved to x11_init
-
-    // If the buffer is not empty, update the graph parameters based on the data
-    if (buffer_size > 0) {
-        // Set the minimum and maximum timestamp to the first and last data point in the buffer
-        graph.min_timestamp = buffer[0].timestamp;
-        graph.max_timestamp = buffer[buffer_size - 1].timestamp;
-        // Set the minimum and maximum value to the first data value in the buffer
-        graph.min_value = buffer[0].values[0];
-        graph.max_value = buffer[0].values[0];
-        // Loop through the buffer and find the minimum and maximum value among all data fields
-        for (int i = 0; i < buffer_size; i++) {
-            for (int j = 0; j < graph.num_fields; j++) {
-                if (buffer[i].values[j] < graph.min_value) {
-                    graph.min_value = buffer[i].values[j];
-                }
-                if (buffer[i].values[j] > graph.max_value) {
-                    graph.max_value = buffer[i].values[j];
-                }
-            }
-        }
+// A function to record one data field of a device drawn by the OpenGL backend
+// The data points appended since the previous frame are staged right away, the history is not read once the lock is released
+void record_draw_series(void *context, int color, SerialDevice *device, int field, double x_latest, double x_per_us, int bottom, float min_value, float y_factor) {
+    if (device->buffer_size < 2) {
+        return;
+    }
+    FrameCommand *command = record_command(FRAME_DRAW_SERIES, color, device - devices, field, 0, bottom);
+    if (command == NULL) {
+        return;
+    }
+    gl_stage_series(device);
+    command->x_latest = x_latest;
+    command->x_per_us = x_per_us;
+    command->min_value = min_value;
+    command->y_factor = y_factor;
+}
 
-        // Add some margin to the minimum and maximum value
-        float margin = (graph.max_value - graph.min_value) * INTERNAL_GRAPH_MARGIN;
-        graph.min_value -= margin;
-        graph.max_value += margin;
+// A global variable to store the renderer recording the frames
+PlotRenderer frame_recorder;
 
-        // If the minimum and maximum value are equal, set them to 0 and 1
-        if (graph.min_value == graph.max_value) {
-            graph.min_value = 0;
-            graph.max_value = 1;
-        }
+// Global variables to store the size the static layer was recorded with last, it is recorded again when the window size changed
+int static_recorded_width = 0, static_recorded_height = 0;
+
+// A function to record the static layer, its primitives are only recorded when it changed or the window size did,
+// otherwise the backend shows the layer it kept
+void record_static_layer(void *context, int rebuild, void (*draw)(PlotRenderer *renderer)) {
+    if (static_recorded_width != graph.width || static_recorded_height != graph.height) {
+        rebuild = True;
+    }
+    int begin = frame_num_commands;
+    FrameCommand *command = record_command(FRAME_STATIC_BEGIN, 0, 0, 0, graph.width, graph.height);
+    if (command == NULL) {
+        return;
+    }
+    command->count = rebuild;
+    if (rebuild) {
+        draw(&frame_recorder);
+    }
+    if (record_command(FRAME_STATIC_END, 0, 0, 0, graph.width, graph.height) == NULL) {
+        // a layer cut short is left out, the next frame records it again
+        frame_num_commands = begin;
+        static_recorded_width = 0;
+        return;
+    }
+    frame_commands[begin].first = frame_num_commands - 1;
+    if (rebuild) {
+        static_recorded_width = graph.width;
+        static_recorded_height = graph.height;
+    }
+}
+
+PlotRenderer frame_recorder = {NULL, record_fill_rectangle, record_draw_rectangle, record_draw_line, record_draw_polyline, record_draw_text, NULL, record_draw_image, record_static_layer, record_draw_polyline_relative};
+
+// A function to start recording a frame
+void start_recording() {
+    frame_num_commands = 0;
+    frame_num_points = 0;
+    frame_text_length = 0;
+}
+
+// Global variables to store the range of recorded primitives of the static layer being drawn
+int static_first = 0, static_end = 0;
+
+// A function to draw a range of the recorded primitives with a render backend
+void replay_commands(PlotRenderer *backend, int first, int end);
+
+// A function to draw the recorded primitives of the static layer, the backend calls it when it draws the layer again
+void replay_static_layer(PlotRenderer *backend) {
+    replay_commands(backend, static_first, static_end);
+}
 
-        // If the minimum and maximum timestamp are equal, set them to 0 and 1000
-        if (graph.min_timestamp == graph.max_timestamp) {
-            graph.min_timestamp = 0;
-            graph.max_timestamp = 1000;
+void replay_commands(PlotRenderer *backend, int first, int end) {
+    for (int c = first; c < end; c++) {
+        FrameCommand *command = &frame_commands[c];
+        switch (command->op) {
+            case FRAME_FILL_RECTANGLE:
+                backend->fill_rectangle(backend->context, command->color, command->x, command->y, command->width, command->height);
+                break;
+            case FRAME_DRAW_RECTANGLE:
+                backend->draw_rectangle(backend->context, command->color, command->x, command->y, command->width, command->height);
+                break;
+            case FRAME_DRAW_LINE:
+                backend->draw_line(backend->context, command->color, command->x, command->y, command->width, command->height);
+                break;
+            case FRAME_DRAW_POLYLINE:
+                backend->draw_polyline(backend->context, command->color, frame_points + command->first, command->count);
+                break;
+            case FRAME_DRAW_POLYLINE_RELATIVE:
+                backend->draw_polyline_relative(backend->context, command->color, frame_points + command->first, command->count);
+                break;
+            case FRAME_DRAW_TEXT:
+                backend->draw_text(backend->context, command->color, command->x, command->y, frame_text + command->first);
+                break;
+            case FRAME_DRAW_IMAGE:
+                backend->draw_image(backend->context, command->x, command->y, command->width, command->height, command->pixels);
+                break;
+            case FRAME_DRAW_SERIES:
+                gl_draw_staged_series(command->color, command->x, command->y, command->x_latest, command->x_per_us, command->height,
+                                      command->min_value, command->y_factor);
+                break;
+            case FRAME_STATIC_BEGIN:
+                // the primitives of the layer are drawn by the backend if it draws the layer again, then skipped
+                static_first = c + 1;
+                static_end = command->first;
+                backend->static_layer(backend->context, command->count, replay_static_layer);
+                c = command->first;
+                break;
         }
     }
 }
 
-// A function to draw the graph on the window
+// A function to draw the recorded frame with the render backend, Xlib requests on the connection of the render thread or OpenGL
+// It runs without the lock, Xlib may wait here for a slow X server to read its requests
+void replay_frame() {
+    replay_commands(backend, 0, frame_num_commands);
+}
+
+// A function to draw the graph on the window, called by the render thread with the lock held
+// Only the layout runs under the lock: the frame is recorded, the OpenGL backend stages the new data points and the raster
+// modes hand over their lines or hits. The lock is released while the raster is faded and presented, the recorded frame is
+// sent or drawn with OpenGL, the buffers are swapped and the frame is synced, so neither the ingest nor the window events
+// wait for the pixel passes, OpenGL or the X server
 void draw_graph() {
-	switch (color_theme) {
-
-	case 1 :   // dark color theme
-    // Clear the window with white color
-    XSetForeground(display, gc, pixels[COLOR_BLACK]);
-    XFillRectangle(display, window, gc, 0, 0, graph.width, graph.height);
-    // Draw the x-axis and y-axis with black color
-    XSetForeground(display, gc, pixels[COLOR_WHITE]);
-	break;
-
-	default : 
-    // Clear the window with white color
-    XSetForeground(display, gc, pixels[COLOR_WHITE]);
-    XFillRectangle(display, window, gc, 0, 0, graph.width, graph.height);
-    // Draw the x-axis and y-axis with black color
-    XSetForeground(display, gc, pixels[COLOR_BLACK]);
-	break;
-        }
+    int64_t trace = trace_begin();
+    // the drawing is measured without the performance overlay itself
+    Bool timed = show_perf;
+    int64_t probe = 0;
+    if (timed) {
+        probe = perf_now();
+        perf_transform_time = 0;
+    }
+    // the latency of the data points received so far is measured once this frame is presented
+    if (latency_mode) {
+        memcpy(frame_receive_times, pending_receive_times, num_pending * sizeof(double));
+        memcpy(frame_markers, pending_markers, num_pending * sizeof(uint32_t));
+        frame_num_pending = window_exposed ? num_pending : 0;
+        num_pending = 0;
+    }
+    Bool present = latency_mode && window_exposed;
+    // Measure the time to the first pixel once, when the first data point was drawn into the visible window
+    Bool first_pixel = first_pixel_time < 0 && first_sample_time >= 0 && window_exposed;
+
+    start_recording();
+    draw_frame(renderer);
+    int64_t layout = 0;
+    if (timed) {
+        perf_record(PERF_TRANSFORM, perf_transform_time);
+        layout = perf_now() - probe - perf_transform_time;
+        // the requests of a frame are known once it was sent, the overlay shows those of the previous one
+        draw_perf_overlay(renderer);
+        // the lock was taken for this frame before update_graph()
+        perf_record(PERF_LOCK, perf_now() - frame_locked);
+    }
 
-//    XDrawLine(display, window, gc, MARGIN, MARGIN, MARGIN, graph.height - MARGIN);
-//    XDrawLine(display, window, gc, MARGIN, graph.height - MARGIN, graph.width - MARGIN, graph.height - MARGIN);
-    // Draw the x-axis and y-axis labels with black color
-    char label[32];
-    sprintf(label, "%ld ms", graph.min_timestamp);
-    XDrawString(display, window, gc, MARGIN, graph.height - MARGIN + MARGIN/2, label, strlen(label));
-    sprintf(label, "%ld ms", graph.max_timestamp);
-    XDrawString(display, window, gc, graph.width - MARGIN - 40, graph.height - MARGIN + MARGIN/2, label, strlen(label));
-    sprintf(label, "%.2f", graph.min_value);
-    XDrawString(display, window, gc, MARGIN - MARGIN, graph.height - MARGIN + 0, label, strlen(label));
-    sprintf(label, "%.2f", graph.max_value);
-    XDrawString(display, window, gc, MARGIN - MARGIN, MARGIN + 0, label, strlen(label));
-
-    float x_factor = ( (float) graph.width / (graph.max_timestamp - graph.min_timestamp) ); // calculate once to optimize loops
-    float y_factor = (graph.height - 1 * MARGIN) / (graph.max_value - graph.min_value);
-    // Draw the data points and lines with different colors for each data field
-    for (int i = 0; i < graph.num_fields; i++) {
-        // Set the foreground color to the corresponding color for the data field
-        XSetForeground(display, gc, pixels[graph.colors[i]]);
-        // Loop through the buffer and draw the data points and lines
-        for (int j = 0; j < buffer_size; j++) {
-            // Calculate the x and y coordinates of the data point on the window
-//            unsigned int x = MARGIN + (buffer[j].timestamp - graph.min_timestamp) * (graph.width - 1 * MARGIN) / (graph.max_timestamp - graph.min_timestamp);
-//            unsigned int y = graph.height - MARGIN - (buffer[j].values[i] - graph.min_value) * (graph.height - 1 * MARGIN) / (graph.max_value - graph.min_value);
-//            unsigned int x = ((buffer[j].timestamp - graph.min_timestamp) * ( (float) graph.width / (graph.max_timestamp - graph.min_timestamp) ));
-            uint16_t x = ( (buffer[j].timestamp - graph.min_timestamp) * x_factor);
-//            unsigned int y = graph.height - MARGIN - (buffer[j].values[i] - graph.min_value) * (graph.height - 1 * MARGIN) / (graph.max_value - graph.min_value);
-            uint16_t y = graph.height - MARGIN - (buffer[j].values[i] - graph.min_value) * y_factor;
-            // Draw a small circle around the data point
-#ifdef DATA_POINT_CIRCLE
-            XFillArc(display, window, gc,
-                     x - 2, y - 2,
-                     4, 4,
-                     0, 360 * 64);
-#endif // DATA_POINT_CIRCLE
-            // If this is not the first data point in the buffer, draw a line from the previous data point to this one
-            if (j > 0) {
-                // Calculate the x and y coordinates of the previous data point on the window
-//                int prev_x = MARGIN + (buffer[j-1].timestamp - graph.min_timestamp) * (graph.width - 1 * MARGIN) / (graph.max_timestamp - graph.min_timestamp);
-//                int prev_y = graph.height - MARGIN - (buffer[j-1].values[i] - graph.min_value) * (graph.height - 1 * MARGIN) / (graph.max_value - graph.min_value);
-//                uint16_t prev_x = (buffer[j-1].timestamp - graph.min_timestamp) * (graph.width) / (graph.max_timestamp - graph.min_timestamp);
-//                uint16_t prev_y = graph.height - MARGIN - (buffer[j-1].values[i] - graph.min_value) * (graph.height - 1 * MARGIN) / (graph.max_value - graph.min_value);
-                uint16_t prev_x = (buffer[j-1].timestamp - graph.min_timestamp) * x_factor;
-                uint16_t prev_y = graph.height - MARGIN - (buffer[j-1].values[i] - graph.min_value) * y_factor;
-                // Draw a line from the previous data point to this one
-                XDrawLine(display, window, gc,
-                          prev_x, prev_y,
-                          x, y);
-            }
-        }
+    pthread_mutex_unlock(&core_lock);
+    probe = timed ? perf_now() : 0;
+    render_raster();
+    unsigned long first_request = NextRequest(display);
+    if (gl_mode) {
+        gl_begin_frame();
+    }
+    replay_frame();
+    unsigned long requests = NextRequest(display) - first_request;
+    int64_t replay = timed ? perf_now() - probe : 0;
+    trace_end(&render_trace, TRACE_RENDER, trace);
+    trace = trace_begin();
+    if (gl_mode) {
+        // with vsync the swap is paced by the vertical blank, the frame is shown at the next one
+        gl_swap_buffers();
+    } else {
+        XFlush(display);
     }
+    trace_end(&render_trace, TRACE_FLUSH, trace);
+    // XSync waits until the X server has executed the drawing, in the latency mode every frame is synced
+    if (present) {
+        present_frame();
+    } else if (first_pixel) {
+        sync_frame();
+    }
+    double present_time = host_time_ms();
+    pthread_mutex_lock(&core_lock);
 
-    // Flush the output buffer to display the graph on the window
-//    XFlush(display);
+    if (timed) {
+        // the OpenGL backend counts its draw calls instead of X requests
+        perf_requests = gl_mode ? gl_draw_calls : requests;
+        perf_record(PERF_DRAW, layout + replay);
+    }
+    if (first_pixel) {
+        first_pixel_time = present_time;
+        fprintf(stderr, "Startup: serial ports open after %.1f ms, window after %.1f ms, first data point after %.1f ms, first pixel after %.1f ms\n",
+                serial_ready_time, x11_ready_time, first_sample_time, first_pixel_time);
+    }
+}
+
+// A function to ask the render thread for a frame right away, called with the lock held
+void request_frame() {
+    frame_requested = True;
+    pthread_cond_signal(&frame_cond);
+}
+
+// A function called by the core for every data point accepted into a history
+void data_point_received(SerialDevice *device, uint32_t counter, double host_time) {
+    new_serial_data = True;
+    if (first_sample_time < 0) {
+        first_sample_time = host_time;
+    }
+    if (latency_mode && num_pending < LATENCY_PENDING) {
+        pending_receive_times[num_pending] = host_time;
+        pending_markers[num_pending] = counter;
+        num_pending++;
+    }
 }
 
 void handle_keypress(XKeyEvent *event) {
@@ -446,190 +808,503 @@ void handle_keypress(XKeyEvent *event) {
     if ((n == 1) && ((buffer[0] == 'q') || (buffer[0] == 'Q'))) {
         keypress = True;
     }
+    // Toggle between stacked panes and one merged view if m or M is pressed
+    if ((n == 1) && ((buffer[0] == 'm') || (buffer[0] == 'M'))) {
+        merged_view = !merged_view;
+        request_frame();
+    }
+    // Toggle between the time plot and the XY plot if x or X is pressed
+    if ((n == 1) && ((buffer[0] == 'x') || (buffer[0] == 'X'))) {
+        xy_mode = !xy_mode;
+        density_mode = 0;
+        scope_mode = 0;
+        request_frame();
+    }
+    // Toggle between the time plot and the density plot if d or D is pressed
+    if ((n == 1) && ((buffer[0] == 'd') || (buffer[0] == 'D'))) {
+        density_mode = !density_mode;
+        xy_mode = 0;
+        scope_mode = 0;
+        request_frame();
+    }
+    // Toggle between the time plot and the triggered scope plot if o or O is pressed
+    if ((n == 1) && ((buffer[0] == 'o') || (buffer[0] == 'O'))) {
+        scope_mode = !scope_mode;
+        xy_mode = 0;
+        density_mode = 0;
+        request_frame();
+    }
+    // Toggle the ingest statistics overlay if s or S is pressed
+    if ((n == 1) && ((buffer[0] == 's') || (buffer[0] == 'S'))) {
+        show_stats = !show_stats;
+        request_frame();
+    }
+    // Write the trace collected so far if t or T is pressed and tracing is on
+    if ((n == 1) && ((buffer[0] == 't') || (buffer[0] == 'T')) && trace_file != NULL) {
+        trace_requested = True;
+    }
+    // Toggle the performance overlay if p or P is pressed, the timings start over each time it is shown
+    if ((n == 1) && ((buffer[0] == 'p') || (buffer[0] == 'P'))) {
+        show_perf = !show_perf;
+        memset(perf_stages, 0, sizeof(perf_stages));
+        perf_last_frame = 0;
+        request_frame();
+    }
 }
 
-// A function to handle the events from the X11 server
+// A function to handle the events queued from the X11 server
+// They are drained first and compressed: only the latest size of a resize counts, and the regions of an Expose series are merged
+// into one redraw of the whole window once its last Expose (count 0) arrived. A resize storm then asks the render thread for one
+// frame, which it draws at most once per frame interval. The keys change the state under the lock right away
 void handle_events() {
     // Initialize an event structure to store the event
     XEvent event;
-    // Loop until a key press event is received
-        // Wait for an event from the X11 server
-        XNextEvent(display, &event);
+    Bool configured = False, exposed = False;
+    int width = 0, height = 0;
+    while (XPending(event_display) > 0) {
+        XNextEvent(event_display, &event);
         // Check the type of the event
         switch (event.type) {
-            // If it is an expose event, redraw the graph
+            // If it is the last expose event of a series, redraw the graph
             case Expose:
-                update_graph(); // just in case we were sleeping and data came in asynchronously
-                draw_graph();
+                if (event.xexpose.count == 0) {
+                    exposed = True;
+                }
                 break;
 
             // If it is a key press event, exit the loop
             case KeyPress:
-		handle_keypress(&event.xkey);
+                pthread_mutex_lock(&core_lock);
+                handle_keypress(&event.xkey);
+                pthread_mutex_unlock(&core_lock);
                 break;
 
-            // If it is a configure notify event, update the window size and redraw the graph
+            // If it is a configure notify event, keep the window size, the latest one is applied after the queue is drained
             case ConfigureNotify:
-                graph.width = event.xconfigure.width;
-                graph.height = event.xconfigure.height;
-                update_graph();  // in case data got updated asynchronously
-                draw_graph();
+                configured = True;
+                width = event.xconfigure.width;
+                height = event.xconfigure.height;
                 break;
 
             // Ignore other types of events
             default:
                 break;
         }
+    }
+    if (!configured && !exposed) {
+        return;
+    }
+    pthread_mutex_lock(&core_lock);
+    // a ConfigureNotify of a move keeps the size, the window only needs drawing again if it also was exposed
+    if (configured && (width != window_width || height != window_height)) {
+        window_width = width;
+        window_height = height;
+        request_frame();
+    }
+    if (exposed) {
+        window_exposed = True;
+        request_frame();
+    }
+    pthread_mutex_unlock(&core_lock);
 }
 
 // libev event loop
 struct ev_loop *loop;
-// libev io watcher
-ev_io serial_watcher;
+// libev io watcher of the X server connection
+ev_io x11_watcher;
+// libev prepare watcher handling X events already queued by Xlib before the loop blocks
+ev_prepare x11_prepare;
+// libev signal watchers ending the loop on SIGINT/SIGTERM, so the statistics are printed like on q
+ev_signal sigint_watcher;
+ev_signal sigterm_watcher;
+
 // callback function for serial port data available event
+// Reads everything available in one chunk and splits it into lines, so one slow device never blocks the others
 void serial_cb(EV_P_ ev_io *w, int revents)
 {
-  //  printf("Data available\n");
-    // read data up to newline from serial port
-//    char line[LINE_SIZE];
-//    int n = readline(serial_fd, line, LINE_SIZE);
-//    new_serial_data = True; 
-        int result = read_data_point(&data_point);
-    if (result == -1)
-    {
-        perror("error reading data");
-        exit(1);
+    SerialDevice *device = (SerialDevice *) w->data;
+    char chunk[SERIAL_READ_CHUNK];
+    int64_t trace = trace_begin();
+    int n = read(device->fd, chunk, sizeof(chunk));
+    trace_end(&main_trace, TRACE_READ, trace);
+    // every line completed by this chunk is stamped with one clock read taken right after the read
+    double host_time = host_time_ms();
+    if (n == -1 && (errno == EAGAIN || errno == EINTR)) {
+        return;
     }
-    else if (result == 0)
-    {
-//        printf("No more data\n");
-        return ;
+    if (n <= 0) {
+        // end of file or error, the device went away
+        fprintf(stderr, "Error: Cannot read from %s\n", device->name);
+        ev_io_stop(EV_A_ w);
+        close_source(device);
+        return;
     }
-    else
-    {
-//        printf("Read %d bytes: \n", result);
-    new_serial_data = True; 
+    // the lock is only held while the chunk is ingested, the render thread holds it only while it lays out a frame
+    pthread_mutex_lock(&core_lock);
+    int64_t probe = show_perf ? perf_now() : 0;
+    trace = trace_begin();
+    frame_chunk(device, chunk, n, host_time);
+    trace_end(&main_trace, TRACE_PARSE, trace);
+    if (show_perf) {
+        perf_record(PERF_PARSE, perf_now() - probe);
     }
+    // Draw the first data point right away instead of on the next frame
+    if (first_pixel_time < 0 && new_serial_data == True && window_exposed) {
+        request_frame();
+    }
+    pthread_mutex_unlock(&core_lock);
+}
 
-    new_serial_data = True ;// set flag indicating there is new serial data avail
-    // Return success
-    return ;
-//    float data_point = strtof(line, NULL);
-//    printf("Data point: %f\n", data_point);
+// callback function for X server connection readable event
+void x11_cb(EV_P_ ev_io *w, int revents)
+{
+    handle_events();
+    if (trace_requested == True) {
+        trace_requested = False;
+        dump_trace();
+    }
+    if (keypress == True) {
+        ev_break(EV_A_ EVBREAK_ALL);
+    }
+}
+
+// callback function run before the event loop blocks
+// Xlib may have read events into its queue while drawing, those would never wake up the io watcher
+void x11_prepare_cb(EV_P_ ev_prepare *w, int revents)
+{
+    x11_cb(EV_A_ &x11_watcher, 0);
+    XFlush(event_display);
+}
+
+// A function to draw a frame if anything changed since the previous one, called by the render thread with the lock held
+// Return whether a frame was drawn
+Bool render_frame(Bool requested) {
+    // update the per-device line rates and driver counters once per statistics interval
+    static double last_stats = 0;
+    double now = host_time_ms() / 1000.0;
+    if (now - last_stats >= STATS_INTERVAL) {
+        double host_time = host_time_ms();
+        for (int d = 0; d < num_devices; d++) {
+            devices[d].line_rate = (devices[d].stats.lines - devices[d].lines_at_last_stats) / (now - last_stats);
+            devices[d].lines_at_last_stats = devices[d].stats.lines;
+            read_driver_counters(&devices[d], host_time);
+        }
+        last_stats = now;
+        new_serial_data = True; // the statistics changed, redraw them
+    }
+
+    // the XY and density modes keep drawing while their rasters fade, the scope mode only draws new captures
+    if (requested || (scope_mode ? new_capture() : (new_serial_data == True || raster_animating()))) {
+        new_serial_data = False ; // reset new serial data flag
+        if (show_perf) {
+            // frame interval and data points received since the previous frame
+            int64_t frame = perf_now();
+            uint32_t lines = 0;
+            for (int d = 0; d < num_devices; d++) {
+                lines += devices[d].stats.lines;
+            }
+            if (perf_last_frame != 0) {
+                perf_record(PERF_FRAME_INTERVAL, frame - perf_last_frame);
+                perf_samples_per_frame = lines - perf_lines_at_last_frame;
+            }
+            perf_last_frame = frame;
+            perf_lines_at_last_frame = lines;
+        }
+        // the window size is only changed here, the render thread reads graph without the lock while it draws
+        graph.width = window_width;
+        graph.height = window_height;
+        // Update the graph parameters based on the buffers
+        int64_t probe = show_perf ? perf_now() : 0;
+        frame_locked = probe;
+        int64_t trace = trace_begin();
+        update_graph();
+        trace_end(&render_trace, TRACE_AUTOSCALE, trace);
+        if (show_perf) {
+            perf_record(PERF_AUTOSCALE, perf_now() - probe);
+        }
+        // Draw the graph on the window
+        draw_graph();
+        return True;
+    }
+    return False;
+}
+
+// A function to read CLOCK_MONOTONIC in seconds, the clock the render thread waits on
+double monotonic_seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// The function of the thread opening the devices: it opens the serial port, or the source the device name selects,
+// of every device with its baud rate and records when all of them were open
+void *open_main(void *arg) {
+    for (int d = 0; d < num_devices; d++) {
+        open_source(&devices[d]);
+    }
+    serial_ready_time = host_time_ms();
+    return NULL;
+}
+
+// The function of the render thread: it opens its own display connection and draws a frame every frame interval
+// when something changed, or as soon as one is requested, until render_running is cleared
+// A frame is drawn at most once per frame interval however many are requested, the window resources such as the
+// static layer pixmap, the raster and the OpenGL texture follow the window size only when a frame is drawn
+void *render_main(void *arg) {
+    render_trace.tid = syscall(SYS_gettid);
+    init_render_connection();
+    double next = monotonic_seconds(); // time of the next periodic frame
+    double last_frame = next - FRAME_INTERVAL; // time the latest frame was drawn
+    pthread_mutex_lock(&core_lock);
+    while (render_running) {
+        double now = monotonic_seconds();
+        double deadline = frame_requested ? now : next;
+        if (deadline < last_frame + FRAME_INTERVAL) {
+            deadline = last_frame + FRAME_INTERVAL;
+        }
+        if (now < deadline) {
+            // the lock is released while waiting, a signal or the deadline ends the wait
+            struct timespec wait;
+            wait.tv_sec = deadline;
+            wait.tv_nsec = (deadline - wait.tv_sec) * 1e9;
+            pthread_cond_timedwait(&frame_cond, &core_lock, &wait);
+            continue;
+        }
+        if (now >= next) {
+            // after a frame longer than the interval the next one is an interval from now instead of catching up
+            next = (now - next >= FRAME_INTERVAL) ? now + FRAME_INTERVAL : next + FRAME_INTERVAL;
+        }
+        Bool requested = frame_requested;
+        frame_requested = False;
+        if (render_frame(requested)) {
+            last_frame = now;
+        }
+    }
+    pthread_mutex_unlock(&core_lock);
+    close_render_connection();
+    return NULL;
+}
+
+// callback function for SIGINT/SIGTERM
+void signal_cb(EV_P_ ev_signal *w, int revents)
+{
+    ev_break(EV_A_ EVBREAK_ALL);
 }
 
 // The main function of the program
+// A function to print the command line usage and exit
+void usage(char *program) {
+    fprintf(stderr, "Usage: %s [-b <baud rate>] [-l] <color theme number> <serial device> <number of data fields> [<serial device> <number of data fields> ...]\n", program);
+    fprintf(stderr, "       a device is a serial port, or pty:<path>, replay:<recorded CSV file>, tcp:<host>:<port> or unix:<socket path>\n");
+    fprintf(stderr, "       -b sets the baud rate of all devices (default %d), any rate supported by the driver works\n", BAUD_RATE);
+    fprintf(stderr, "       -l switches the serial drivers to their low latency mode\n");
+    fprintf(stderr, "       -g draws with OpenGL, the buffer swaps follow the vertical blank\n");
+    fprintf(stderr, "       -a <seconds> the value range of a pane shrinks once the data fit into a smaller one that long (default %.0f), it grows at once\n", AUTOSCALE_HYSTERESIS);
+    fprintf(stderr, "       -w <seconds> fixes the time window of the x-axis, the data points are reduced to %d min/max buckets across it\n", WINDOW_BUCKETS);
+    fprintf(stderr, "       -X <x field>,<y field>[,<samples>] plots one data field against another with fading traces (x toggles), e.g. -X 1,2\n");
+    fprintf(stderr, "       -D <sweep ms> shows how often the samples of all data fields hit each pixel of a sweep (d toggles), e.g. -D 20\n");
+    fprintf(stderr, "       -T <field>,<level>[,r|f[,<window ms>[,<pre-trigger %%>[,<holdoff ms>]]]] shows the window around each rising (r) or falling (f)\n"
+                    "          crossing of the level by the field, redrawn only for a new capture (o toggles), e.g. -T 1,0.5,r,20,25\n");
+    fprintf(stderr, "       -p shows the performance overlay from the start, its timings are printed on exit\n");
+    fprintf(stderr, "       -t records read, parse, append, autoscale, render and X flush events, written as Chrome trace JSON on exit or when t is pressed\n");
+    fprintf(stderr, "       -L measures the latency from receiving each data point to the X server having drawn it, printed on exit\n");
+    fprintf(stderr, "       -M like -L, and also from sending it, for devices sending CLOCK_MONOTONIC micros() of this host (serial_generator -u)\n");
+    fprintf(stderr, "       up to %d devices, press m to toggle stacked panes and merged view, s to show ingest statistics, p to show timings\n", MAX_DEVICES);
+    fprintf(stderr, "       append :us to the number of data fields of a device sending micros() timestamps, e.g. 4:us\n");
+    exit(1);
+}
+
 int main(int argc, char **argv) {
+    // The start time is taken first, the startup report measures the time to the first pixel from here
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    // the main and the render thread use Xlib at the same time, each on its own connection
+    XInitThreads();
+
+    // Get the options, the positional arguments keep their indices after the options are skipped
+    int option;
+    while ((option = getopt(argc, argv, "b:lgpLMt:a:w:X:D:T:")) != -1) {
+        switch (option) {
+            case 'b':
+                baud_rate = atoi(optarg);
+                if (baud_rate <= 0) {
+                    usage(argv[0]);
+                }
+                break;
+            case 'l':
+                low_latency = True;
+                break;
+            case 'g':
+                gl_mode = True;
+                break;
+            case 'p':
+                show_perf = True;
+                break;
+            case 'L':
+                latency_mode = (latency_mode == 2) ? 2 : 1;
+                break;
+            case 'M':
+                latency_mode = 2;
+                break;
+            case 't':
+                trace_file = optarg;
+                break;
+            case 'a':
+                autoscale_hysteresis = atof(optarg);
+                if (autoscale_hysteresis < 0) {
+                    usage(argv[0]);
+                }
+                break;
+            case 'w':
+                parse_window_span(optarg);
+                break;
+            case 'X':
+                parse_xy_mode(optarg);
+                break;
+            case 'D':
+                parse_density_mode(optarg);
+                break;
+            case 'T':
+                parse_scope_mode(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    argv[optind - 1] = argv[0];
+    argc -= optind - 1;
+    argv += optind - 1;
 
     // Check if the command line arguments are valid
-    if (argc != 4) {
-        fprintf(stderr, "Usage: %s <color theme number> <serial device> <number of data fields>\n", argv[0]);
-        exit(1);
+    if (argc < 4 || (argc - 2) % 2 != 0 || (argc - 2) / 2 > MAX_DEVICES) {
+        usage(argv[0]);
     }
 
-    // Get the serial device name and number of data fields from the command line arguments
+    // Get the serial device names and numbers of data fields from the command line arguments
     color_theme = atoi(argv[1]); // TODO : implement better color theme handling. now it is simple case: hack
-    char *device = argv[2];
-    int num_fields = atoi(argv[3]);
-    // Check if the number of data fields is valid
-    if (num_fields < 1 || num_fields > MAX_DATA_FIELDS) {
-        fprintf(stderr, "Error: Number of data fields must be between 1 and %d\n", MAX_DATA_FIELDS);
+    num_devices = (argc - 2) / 2;
+    for (int d = 0; d < num_devices; d++) {
+        // Initialize the number of data fields and the history of the device
+        parse_device(&devices[d], argv[2 + 2 * d], argv[3 + 2 * d]);
+        devices[d].trace = &main_trace;
+        if (latency_mode == 2 && devices[d].timestamp_unit != 1) {
+            fprintf(stderr, "Error: -M needs micros() marker timestamps, append :us to the number of data fields of %s\n", devices[d].name);
+            exit(1);
+        }
+    }
+    data_point_hook = data_point_received;
+    if (trace_file != NULL) {
+        init_trace_ring(&main_trace, getpid());
+        init_trace_ring(&render_trace, 0);
+        tracing = 1;
+    }
+    if (latency_mode) {
+        receive_latencies = malloc(LATENCY_SAMPLES * sizeof(float));
+        marker_latencies = malloc(LATENCY_SAMPLES * sizeof(float));
+        if (receive_latencies == NULL || marker_latencies == NULL) {
+            fprintf(stderr, "Error: Cannot allocate the latency arrays\n");
+            exit(1);
+        }
+    }
+
+    // Open the serial ports on a helper thread while the main thread connects to the X server, the drivers
+    // buffer the incoming lines until the main loop reads them, and neither waits for the other
+    if (pthread_create(&open_thread, NULL, open_main, NULL) != 0) {
+        fprintf(stderr, "Error: Cannot start the thread opening the devices\n");
         exit(1);
     }
 
     // Initialize the X11 display and window with a title
     char title[64];
-    sprintf(title, "%s q to quit. ", device);
+    if (num_devices == 1) {
+        snprintf(title, sizeof(title), "%s q to quit. ", devices[0].name);
+    } else {
+        snprintf(title, sizeof(title), "%s +%d q to quit. m to merge. ", devices[0].name, num_devices - 1);
+    }
+    // the frames are recorded under the lock and drawn by the backend without it, the raster passes too
+    renderer = &frame_recorder;
+    backend = gl_mode ? &gl_renderer : &xlib_renderer;
+    if (gl_mode) {
+        // the OpenGL backend draws the data series from its vertex buffers, the recorder stages them
+        frame_recorder.draw_series = record_draw_series;
+        frame_recorder.draw_polyline_relative = NULL;
+    }
+    defer_raster = 1;
     init_x11(title);
+    graph.width = WINDOW_WIDTH;
+    graph.height = WINDOW_HEIGHT;
+    x11_ready_time = host_time_ms();
+    // the devices have to be open before their watchers are started
+    pthread_join(open_thread, NULL);
+
+    // Start the render thread, its frame interval timeouts are measured on CLOCK_MONOTONIC like the frame times
+    pthread_condattr_t condattr;
+    pthread_condattr_init(&condattr);
+    pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&frame_cond, &condattr);
+    pthread_condattr_destroy(&condattr);
+    // SIGINT and SIGTERM are blocked in the render thread, libev receives them in the main thread
+    sigset_t signals, old_signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, &old_signals);
+    if (pthread_create(&render_thread, NULL, render_main, NULL) != 0) {
+        fprintf(stderr, "Error: Cannot start the render thread\n");
+        exit(1);
+    }
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
 
-    // Initialize the number of data fields in the graph
-    graph.num_fields = num_fields;
-    // Initialize the buffer size to zero
-    buffer_size = 0;
-
-    // Initialize the serial port with the device name and a baud rate 
-    init_serial(device, BAUD_RATE);
-
-    // set file descriptor as blocking
-    fcntl(serial_fd, F_SETFL, 0);
     // create default event loop
     loop = ev_default_loop(0);
-    // initialize io watcher for serial port file descriptor
-    ev_io_init(&serial_watcher, serial_cb, serial_fd, EV_READ);
-    // start io watcher
-    ev_io_start(loop, &serial_watcher);
-    // start event loop
-    // ev_run(loop, 0);
-
-        printf("discarding first data points\n");
-
-        int i=0;
-	while (i < DISCARD_DATA_POINTS) {
-    // int result = read_data_point(&data_point);
-	while(!new_serial_data){
-    // printf("Synchronized\n");
-	ev_run(loop,EVRUN_NOWAIT);
-		usleep(1000);
-         }
-	new_serial_data = False; 
-	usleep(5000); 
-	 i++;
-      }
-    // printf("No more data2\n");
 
-    // Loop until the user presses a key
-    while (1) { // lets 
-        // Read a data point from the serial port
-//        int result = read_data_point(&data_point);
-        // Check the result of reading
-
-        if (new_serial_data == True) {
-            // If successful, add the data point to the buffer
-            buffer[buffer_size] = data_point;
-		buffer_size++;
-		new_serial_data = False ; // reset new serial data flag
-            // If the buffer is full, roll the data in the buffer
-            if (buffer_size >= MAX_DATA_POINTS-2) {
-            // memcpy(buffer, buffer + sizeof(DataPoint), 8 * sizeof(DataPoint));
-            // for some reason memcpy and memmove does not work. perhaps structs in buffers are padded?
-		for (int i=0; i<buffer_size; i++) {
-    			buffer[i] = buffer[i+1]; 
-		        }
-                buffer_size--;
-            }
-            // Update the graph parameters based on the buffer
-            update_graph();
-            // Draw the graph on the window
-	// TODO: make it being called periodically on Vsync instead all the time
-            draw_graph();
-        } //if (new_serial_data) {
-
-        else if (!new_serial_data) {
-            // If no data , check if there are new events
-	usleep(1000); // sleep a little.... 
-	ev_run(loop,EVRUN_NOWAIT); // poll for new serial data
-        }
+    for (int d = 0; d < num_devices; d++) {
+        // initialize io watcher for serial port file descriptor, the descriptor stays non-blocking
+        ev_io_init(&watchers[d], serial_cb, devices[d].fd, EV_READ);
+        watchers[d].data = &devices[d];
+        // start io watcher
+        ev_io_start(loop, &watchers[d]);
+    }
 
- //       else if (result == -1) {
-            // If error, exit the program
- //           exit(1);
- //       }
-//	usleep(5000); // sleep a little.... 
-//            update_graph();
-//            draw_graph();
-
-        // Check if there is an event from the X11 server
-        if (XPending(display) > 0) {
-            // Handle the event and break the loop if it is a key press event
-            handle_events();
-		if (keypress == True){
-            break;}
-        }
+    // watch the X server connection in the same loop, the frames are drawn by the render thread
+    ev_io_init(&x11_watcher, x11_cb, ConnectionNumber(event_display), EV_READ);
+    ev_io_start(loop, &x11_watcher);
+    ev_prepare_init(&x11_prepare, x11_prepare_cb);
+    ev_prepare_start(loop, &x11_prepare);
+    ev_signal_init(&sigint_watcher, signal_cb, SIGINT);
+    ev_signal_start(loop, &sigint_watcher);
+    ev_signal_init(&sigterm_watcher, signal_cb, SIGTERM);
+    ev_signal_start(loop, &sigterm_watcher);
+
+    // Loop until the user presses a key
+    ev_run(loop, 0);
+
+    // Stop the render thread, it finishes the frame in flight and closes its display connection
+    pthread_mutex_lock(&core_lock);
+    render_running = False;
+    pthread_cond_signal(&frame_cond);
+    pthread_mutex_unlock(&core_lock);
+    pthread_join(render_thread, NULL);
+
+    // Dump the ingest statistics on exit
+    for (int d = 0; d < num_devices; d++) {
+        read_driver_counters(&devices[d], host_time_ms());
+    }
+    print_ingest_stats(stderr);
+    if (show_perf) {
+        print_perf_stats(stderr);
+    }
+    if (latency_mode) {
+        print_latency_stats(stderr);
+    }
+    if (trace_file != NULL) {
+        dump_trace();
     }
 
-    // Close the serial port
-    close_serial();
-    // Close the X11 display and window
+    for (int d = 0; d < num_devices; d++) {
+        // Close the serial port
+        close_source(&devices[d]);
+    }
+    // Close the X11 window and the display connection of the main thread
     close_x11();
     // Return success
     return 0;
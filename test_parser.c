@@ -0,0 +1,52 @@
+// A test of parse_data_point() from the plotter core: every line of the table is parsed by a device with 2 data fields and
+// must give the expected result, the accepted ones also the expected values. make test builds and runs it.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "plotter_core.h"
+
+// A structure to store one line of the test and what parsing it must give
+typedef struct {
+    const char *line; // Received line without the newline
+    int result; // PARSE_OK or the reason it is rejected
+    float values[2]; // Data values of an accepted line
+} ParseCase;
+
+ParseCase cases[] = {
+    {"1000,1.5,-2", PARSE_OK, {1.5f, -2.0f}},
+    {"1000, 1.5 ,-2 \r", PARSE_OK, {1.5f, -2.0f}},
+    {"", REJECT_EMPTY, {0, 0}},
+    {"x,1,2", REJECT_TIMESTAMP, {0, 0}},
+    {"1000,1,abc", REJECT_VALUE, {0, 0}},
+    {"1000,1", REJECT_FIELD_COUNT, {0, 0}},
+    {"1000,1,2,3", REJECT_FIELD_COUNT, {0, 0}},
+    // strtof() accepts these, the parser must not
+    {"1000,nan,2", REJECT_VALUE, {0, 0}},
+    {"1000,1,NAN", REJECT_VALUE, {0, 0}},
+    {"1000,-nan,2", REJECT_VALUE, {0, 0}},
+    {"1000,inf,2", REJECT_VALUE, {0, 0}},
+    {"1000,1,-Infinity", REJECT_VALUE, {0, 0}},
+    {"1000,1e39,2", REJECT_VALUE, {0, 0}},
+};
+
+int main() {
+    SerialDevice *device = &devices[0];
+    init_device(device, "test", 2, 1000);
+    int failures = 0;
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        char line[LINE_SIZE];
+        strcpy(line, cases[c].line);
+        uint32_t counter;
+        DataPoint data_point;
+        int result = parse_data_point(device, line, strlen(line), &counter, &data_point);
+        if (result != cases[c].result) {
+            fprintf(stderr, "FAIL \"%s\": %s instead of %s\n", cases[c].line, parse_result_names[result], parse_result_names[cases[c].result]);
+            failures++;
+        } else if (result == PARSE_OK && (data_point.values[0] != cases[c].values[0] || data_point.values[1] != cases[c].values[1])) {
+            fprintf(stderr, "FAIL \"%s\": values %g,%g\n", cases[c].line, data_point.values[0], data_point.values[1]);
+            failures++;
+        }
+    }
+    printf("%d of %d parser cases failed\n", failures, (int) (sizeof(cases) / sizeof(cases[0])));
+    return failures > 0;
+}
@@ -1,521 +1,778 @@
-// A pthread based linux program implementing graphing csv input coming from reading serial port (on separate thread) using Wayland.
-
+// A Wayland front end of the plotter core, plotting the CSV data points of one or more serial devices like the event plotter does.
+// The window is an xdg-shell toplevel drawn with cairo into two or three wl_shm buffers backed by a memfd, which are reused
+// across frames. Drawing is paced by wl_surface.frame callbacks: a frame is only drawn once the compositor asked for the next one,
+// and only the rows that changed since the frame on screen are damaged.
+// The devices and the Wayland connection are served by one poll() loop, nothing spins and nothing is allocated per data point.
+// Test without a desktop with a headless compositor, e.g. weston --backend=headless-backend.so --socket=wayland-9 &
+// WAYLAND_DISPLAY=wayland-9 ./wayland_plotter 0 /tmp/ttyFAKE0 4:us
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <pthread.h>
 #include <unistd.h>
-#include <termios.h>
-#include <fcntl.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <linux/input-event-codes.h>
 #include <wayland-client.h>
 #include <cairo/cairo.h>
+#include "xdg-shell-client-protocol.h"
+#include "plotter_core.h"
 
-#define SERIAL_PORT "/dev/ttyS0" // change this to your serial port
-#define SERIAL_BAUD B9600 // change this to your baud rate
-#define SERIAL_BUFFER_SIZE 256 // change this to your buffer size
-#define GRAPH_WIDTH 800 // change this to your graph width
-#define GRAPH_HEIGHT 600 // change this to your graph height
-#define GRAPH_MARGIN 50 // change this to your graph margin
-#define GRAPH_COLOR "red" // change this to your graph color
+#define WINDOW_WIDTH 800 // Initial window width
+#define WINDOW_HEIGHT 600 // Initial window height
+#define STATS_INTERVAL 1.0 // seconds over which the per-device line rate is averaged
+#define SHM_BUFFERS 3 // wl_shm buffers cycled through, a third one is only created when the compositor holds on to two
+#define DAMAGE_GAP 8 // unchanged rows between two changed ones that are still damaged together as one rectangle
 
-// A struct to store the csv data
+// A structure to store one wl_shm buffer and the cairo context drawing into it
 typedef struct {
-    double x; // the x value
-    double y; // the y value
-} csv_data_t;
-
-// A global variable to store the csv data array
-csv_data_t *csv_data = NULL;
-
-// A global variable to store the csv data size
-int csv_data_size = 0;
-
-// A global variable to store the serial port file descriptor
-int serial_fd = -1;
-
-// A global variable to store the wayland display
+    struct wl_buffer *buffer; // Wayland buffer, NULL while the slot is not allocated
+    uint32_t *data; // Pixels, mapped from the memfd shared with the compositor
+    size_t size; // Size of the mapping in bytes
+    int width; // Width in pixels
+    int height; // Height in pixels
+    int stride; // Bytes per row
+    int busy; // Whether the compositor may still read the buffer, until it sends release
+    cairo_surface_t *surface; // cairo image surface on the pixels
+    cairo_t *cairo; // cairo context of the surface
+} ShmBuffer;
+
+// A global variable to store the Wayland display connection
 struct wl_display *display = NULL;
-
-// A global variable to store the wayland registry
+// A global variable to store the Wayland registry
 struct wl_registry *registry = NULL;
-
-// A global variable to store the wayland compositor
+// A global variable to store the Wayland compositor
 struct wl_compositor *compositor = NULL;
-
-// A global variable to store the wayland shell
-struct wl_shell *shell = NULL;
-
-// A global variable to store the wayland surface
+// A global variable to store the version of the compositor interface, damage_buffer needs 4
+uint32_t compositor_version = 0;
+// A global variable to store the Wayland shared memory interface
+struct wl_shm *shm = NULL;
+// A global variable to store the xdg-shell window manager base
+struct xdg_wm_base *wm_base = NULL;
+// A global variable to store the seat the keyboard belongs to
+struct wl_seat *seat = NULL;
+// A global variable to store the keyboard
+struct wl_keyboard *keyboard = NULL;
+// A global variable to store the Wayland surface
 struct wl_surface *surface = NULL;
+// A global variable to store the xdg surface of the surface
+struct xdg_surface *xdg_surface = NULL;
+// A global variable to store the toplevel window role of the surface
+struct xdg_toplevel *toplevel = NULL;
+// A global variable to store the wl_shm buffers
+ShmBuffer buffers[SHM_BUFFERS];
+// a global variable to store the buffer shown on the screen, the next frame is compared against it for the damage
+ShmBuffer *front_buffer = NULL;
+// a global variable to store the cairo context the render backend draws with
+cairo_t *cairo = NULL;
+// a global variable to indicate the first configure event was acknowledged, before that nothing may be attached
+int configured = 0;
+// a global variable to indicate a frame callback is pending, the next frame waits for it
+int frame_pending = 0;
+// a global variable to indicate the graph changed since the last frame
+int dirty = 1;
+// a global variable to stop the main loop
+volatile sig_atomic_t running = 1;
+// a global variable to store the window size requested by the compositor, 0 lets the plotter choose
+int configured_width = 0, configured_height = 0;
+// a global variable to store the CLOCK_MONOTONIC_RAW time of the latest frame, 0 before the first timed frame
+int64_t perf_last_frame = 0;
+// a global variable to store the number of data points received by all devices at the latest frame
+uint32_t perf_lines_at_last_frame = 0;
+
+// A function to create a cairo context drawing like the render backend expects: no antialiasing, one pixel lines, monospace
+cairo_t *create_cairo(cairo_surface_t *surface) {
+    cairo_t *context = cairo_create(surface);
+    cairo_set_antialias(context, CAIRO_ANTIALIAS_NONE);
+    cairo_set_line_width(context, 1.0);
+    cairo_select_font_face(context, "monospace", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size(context, 10.0);
+    return context;
+}
 
-// A global variable to store the wayland shell surface
-struct wl_shell_surface *shell_surface = NULL;
+// Render backend drawing with cairo into the wl_shm buffer of the frame, without antialiasing like Xlib
+// The coordinates of lines are moved to the pixel centers so one pixel wide lines cover exactly one pixel
 
-// A global variable to store the wayland buffer
-struct wl_buffer *buffer = NULL;
+// A function to fill a rectangle with a palette color
+void shm_fill_rectangle(void *context, int color, int x, int y, int width, int height) {
+    cairo_set_source_rgb(cairo, palette_rgb[color][0], palette_rgb[color][1], palette_rgb[color][2]);
+    cairo_rectangle(cairo, x, y, width, height);
+    cairo_fill(cairo);
+}
 
-// A global variable to store the cairo surface
-cairo_surface_t *cairo_surface = NULL;
+// A function to draw the outline of a rectangle with a palette color
+void shm_draw_rectangle(void *context, int color, int x, int y, int width, int height) {
+    cairo_set_source_rgb(cairo, palette_rgb[color][0], palette_rgb[color][1], palette_rgb[color][2]);
+    cairo_rectangle(cairo, x + 0.5, y + 0.5, width, height);
+    cairo_stroke(cairo);
+}
 
-// A global variable to store the cairo context
-cairo_t *cairo_context = NULL;
+// A function to draw a line with a palette color
+void shm_draw_line(void *context, int color, int x1, int y1, int x2, int y2) {
+    cairo_set_source_rgb(cairo, palette_rgb[color][0], palette_rgb[color][1], palette_rgb[color][2]);
+    cairo_move_to(cairo, x1 + 0.5, y1 + 0.5);
+    cairo_line_to(cairo, x2 + 0.5, y2 + 0.5);
+    cairo_stroke(cairo);
+}
 
-// A function to initialize the serial port
-int serial_init() {
-    // Open the serial port in read/write mode, non-blocking mode and no controlling terminal mode
-    serial_fd = open(SERIAL_PORT, O_RDWR | O_NOCTTY | O_NONBLOCK);
-    if (serial_fd == -1) {
-        perror("open");
-        return -1;
+// A function to draw the lines between consecutive points with a palette color, as one path
+void shm_draw_polyline(void *context, int color, PlotPoint *polyline, int count) {
+    if (count < 2) {
+        return;
     }
-
-    // Get the current attributes of the serial port
-    struct termios options;
-    if (tcgetattr(serial_fd, &options) == -1) {
-        perror("tcgetattr");
-        return -1;
+    cairo_set_source_rgb(cairo, palette_rgb[color][0], palette_rgb[color][1], palette_rgb[color][2]);
+    cairo_move_to(cairo, polyline[0].x + 0.5, polyline[0].y + 0.5);
+    for (int j = 1; j < count; j++) {
+        cairo_line_to(cairo, polyline[j].x + 0.5, polyline[j].y + 0.5);
     }
+    cairo_stroke(cairo);
+}
 
-    // Set the input and output baud rate
-    if (cfsetispeed(&options, SERIAL_BAUD) == -1) {
-        perror("cfsetispeed");
-        return -1;
+// A function to draw a polyline whose points after the first are relative to the previous one, as one path
+void shm_draw_polyline_relative(void *context, int color, PlotPoint *polyline, int count) {
+    if (count < 2) {
+        return;
     }
-    if (cfsetospeed(&options, SERIAL_BAUD) == -1) {
-        perror("cfsetospeed");
-        return -1;
+    cairo_set_source_rgb(cairo, palette_rgb[color][0], palette_rgb[color][1], palette_rgb[color][2]);
+    cairo_move_to(cairo, polyline[0].x + 0.5, polyline[0].y + 0.5);
+    for (int j = 1; j < count; j++) {
+        cairo_rel_line_to(cairo, polyline[j].x, polyline[j].y);
     }
+    cairo_stroke(cairo);
+}
 
-    // Set the character size to 8 bits, no parity, one stop bit and no hardware flow control
-    options.c_cflag &= ~CSIZE;
-    options.c_cflag |= CS8;
-    options.c_cflag &= ~PARENB;
-    options.c_cflag &= ~CSTOPB;
-    options.c_cflag &= ~CRTSCTS;
+// A function to draw a string with a palette color, y is its baseline
+void shm_draw_text(void *context, int color, int x, int y, const char *text) {
+    cairo_set_source_rgb(cairo, palette_rgb[color][0], palette_rgb[color][1], palette_rgb[color][2]);
+    cairo_move_to(cairo, x, y);
+    cairo_show_text(cairo, text);
+}
 
-    // Set the raw input mode, no echo, no signal characters and no extended functions
-    options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG | IEXTEN);
+// A function to copy an XRGB8888 image into the buffer, the pixel layout of CAIRO_FORMAT_RGB24
+void shm_draw_image(void *context, int x, int y, int width, int height, const uint32_t *pixels) {
+    cairo_surface_t *image = cairo_image_surface_create_for_data((unsigned char *) pixels, CAIRO_FORMAT_RGB24, width, height, width * sizeof(uint32_t));
+    cairo_set_source_surface(cairo, image, x, y);
+    cairo_rectangle(cairo, x, y, width, height);
+    cairo_fill(cairo);
+    cairo_surface_destroy(image);
+}
 
-    // Set the raw output mode, no processing of output characters
-    options.c_oflag &= ~OPOST;
+// A global variable to store the wl_shm render backend
+PlotRenderer shm_renderer;
 
-    // Set the minimum number of characters for non-canonical read and timeout value
-    options.c_cc[VMIN] = 0;
-    options.c_cc[VTIME] = 10;
+// a global variable to store the image surface holding the static layer, and its cairo context
+cairo_surface_t *static_surface = NULL;
+cairo_t *static_cairo = NULL;
 
-    // Apply the new attributes of the serial port
-    if (tcsetattr(serial_fd, TCSANOW, &options) == -1) {
-        perror("tcsetattr");
-        return -1;
+// A function to free the image surface of the static layer
+void destroy_static_layer() {
+    if (static_surface == NULL) {
+        return;
     }
-
-    return 0;
+    cairo_destroy(static_cairo);
+    cairo_surface_destroy(static_surface);
+    static_surface = NULL;
+    static_cairo = NULL;
 }
 
-// A function to read a line from the serial port
-int serial_read_line(char *buffer, int size) {
-    int index = 0; // the current index of the buffer
-    char c; // the current character read from the serial port
-
-    // Loop until the buffer is full or a newline character is read
-    while (index < size - 1) {
-        // Read one character from the serial port
-        if (read(serial_fd, &c, 1) == 1) {
-            // If the character is a newline, break the loop
-            if (c == '\n') {
-                break;
-            }
-            // Otherwise, store the character in the buffer and increment the index
-            buffer[index] = c;
-            index++;
-        }
-    }
+// A function to draw the static layer from an image surface of the window size, rebuilt only when the core asks for it
+// The layer is drawn into the surface with the global cairo context swapped, then every frame starts by painting it
+void shm_static_layer(void *context, int rebuild, void (*draw)(PlotRenderer *renderer)) {
+    if (static_surface != NULL && (cairo_image_surface_get_width(static_surface) != graph.width || cairo_image_surface_get_height(static_surface) != graph.height)) {
+        destroy_static_layer();
+    }
+    if (static_surface == NULL) {
+        static_surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, graph.width, graph.height);
+        static_cairo = create_cairo(static_surface);
+        rebuild = 1;
+    }
+    if (rebuild) {
+        cairo_t *frame_cairo = cairo;
+        cairo = static_cairo;
+        draw(&shm_renderer);
+        cairo_surface_flush(static_surface);
+        cairo = frame_cairo;
+    }
+    cairo_set_source_surface(cairo, static_surface, 0, 0);
+    cairo_paint(cairo);
+}
 
-    // Terminate the buffer with a null character
-    buffer[index] = '\0';
+PlotRenderer shm_renderer = {NULL, shm_fill_rectangle, shm_draw_rectangle, shm_draw_line, shm_draw_polyline, shm_draw_text, NULL, shm_draw_image, shm_static_layer, shm_draw_polyline_relative};
 
-    // Return the number of characters read
-    return index;
+// A function to handle the release of a buffer, the compositor does not read it any more
+void buffer_release(void *data, struct wl_buffer *wl_buffer) {
+    ShmBuffer *buffer = data;
+    buffer->busy = 0;
 }
 
-// A function to parse a csv line and store the data in the global array
-int csv_parse_line(char *line) {
-    // Allocate memory for a new csv data struct
-    csv_data_t *data = malloc(sizeof(csv_data_t));
-    if (data == NULL) {
-        perror("malloc");
-        return -1;
-    }
+// A struct to store the buffer listener callbacks
+const struct wl_buffer_listener buffer_listener = {
+    .release = buffer_release,
+};
 
-    // Scan the line for two double values separated by a comma
-    if (sscanf(line, "%lf,%lf", &data->x, &data->y) != 2) {
-        fprintf(stderr, "Invalid csv format: %s\n", line);
-        free(data);
-        return -1;
+// A function to free a buffer slot
+void destroy_shm_buffer(ShmBuffer *buffer) {
+    if (buffer->buffer == NULL) {
+        return;
     }
-
-    // Reallocate memory for the global csv data array to fit the new data
-    csv_data = realloc(csv_data, sizeof(csv_data_t) * (csv_data_size + 1));
-    if (csv_data == NULL) {
-        perror("realloc");
-        free(data);
-        return -1;
+    cairo_destroy(buffer->cairo);
+    cairo_surface_destroy(buffer->surface);
+    wl_buffer_destroy(buffer->buffer);
+    munmap(buffer->data, buffer->size);
+    if (front_buffer == buffer) {
+        front_buffer = NULL;
     }
-
-    // Store the new data in the global array and increment the size
-    csv_data[csv_data_size] = *data;
-    csv_data_size++;
-
-    // Free the temporary data struct
-    free(data);
-
-    return 0;
+    memset(buffer, 0, sizeof(*buffer));
 }
 
-// A function to read and parse csv data from the serial port in a separate thread
-void *serial_thread(void *arg) {
-    // Create a buffer to store the serial line
-    char buffer[SERIAL_BUFFER_SIZE];
-
-    // Create a file descriptor set for the select function
-    fd_set fds;
-
-    // Create a timeval struct for the select timeout
-    struct timeval tv;
-
-    // Loop until the thread is canceled
-    while (1) {
-        // Clear the file descriptor set
-        FD_ZERO(&fds);
-
-        // Add the serial port file descriptor to the set
-        FD_SET(serial_fd, &fds);
+// A function to allocate a buffer slot of the given size in a memfd shared with the compositor
+void create_shm_buffer(ShmBuffer *buffer, int width, int height) {
+    buffer->width = width;
+    buffer->height = height;
+    buffer->stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, width);
+    buffer->size = (size_t) buffer->stride * height;
+    int fd = memfd_create("wayland_plotter", MFD_CLOEXEC);
+    if (fd == -1 || ftruncate(fd, buffer->size) == -1) {
+        fprintf(stderr, "Error: Cannot create a shared memory buffer\n");
+        exit(1);
+    }
+    buffer->data = mmap(NULL, buffer->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (buffer->data == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map a shared memory buffer\n");
+        exit(1);
+    }
+    // the pool is only needed to create the buffer, the buffer keeps the memory alive
+    struct wl_shm_pool *pool = wl_shm_create_pool(shm, fd, buffer->size);
+    buffer->buffer = wl_shm_pool_create_buffer(pool, 0, width, height, buffer->stride, WL_SHM_FORMAT_XRGB8888);
+    wl_shm_pool_destroy(pool);
+    close(fd);
+    wl_buffer_add_listener(buffer->buffer, &buffer_listener, buffer);
 
-        // Set the timeout to 1 second
-        tv.tv_sec = 1;
-        tv.tv_usec = 0;
+    // XRGB8888 is the pixel layout of CAIRO_FORMAT_RGB24
+    buffer->surface = cairo_image_surface_create_for_data((unsigned char *) buffer->data, CAIRO_FORMAT_RGB24, width, height, buffer->stride);
+    buffer->cairo = create_cairo(buffer->surface);
+    buffer->busy = 0;
+}
 
-        // Call the select function to check if the serial port is ready for reading
-        int ret = select(serial_fd + 1, &fds, NULL, NULL, &tv);
-        if (ret == -1) {
-            perror("select");
-            break;
-        }
-        else if (ret == 0) {
-            // Timeout, no data available
+// A function to find a buffer to draw the next frame into, the one on the screen is kept for the damage comparison
+// Buffers of an old window size are freed and allocated again
+// Return NULL if the compositor still reads all of them
+ShmBuffer *next_buffer() {
+    for (int b = 0; b < SHM_BUFFERS; b++) {
+        ShmBuffer *buffer = &buffers[b];
+        if (buffer == front_buffer || buffer->busy) {
             continue;
         }
-        else {
-            // Data available, read a line from the serial port
-            if (serial_read_line(buffer, SERIAL_BUFFER_SIZE) > 0) {
-                // Parse the line and store the data in the global array
-                if (csv_parse_line(buffer) == -1) {
-                    fprintf(stderr, "Failed to parse csv line: %s\n", buffer);
-                }
-            }
+        if (buffer->buffer != NULL && (buffer->width != graph.width || buffer->height != graph.height)) {
+            destroy_shm_buffer(buffer);
+        }
+        if (buffer->buffer == NULL) {
+            create_shm_buffer(buffer, graph.width, graph.height);
         }
+        return buffer;
     }
-
-    // Return NULL as the thread exit value
     return NULL;
 }
 
-// A function to handle the registry global event
-void registry_global(void *data, struct wl_registry *registry, uint32_t id, const char *interface, uint32_t version) {
-    // If the interface is wl_compositor, bind it to the global variable
-    if (strcmp(interface, "wl_compositor") == 0) {
-        compositor = wl_registry_bind(registry, id, &wl_compositor_interface, 1);
+// A function to damage the rows of a buffer that differ from the frame on the screen
+// Changed rows closer than DAMAGE_GAP are merged into one rectangle, so a frame needs a handful of damage requests
+// Return the number of damaged rectangles, 0 if the frame looks like the one on the screen
+int damage_changed_rows(ShmBuffer *buffer) {
+    if (front_buffer == NULL || front_buffer->width != buffer->width || front_buffer->height != buffer->height) {
+        wl_surface_damage_buffer(surface, 0, 0, buffer->width, buffer->height);
+        return 1;
+    }
+    int rectangles = 0;
+    int top = -1, bottom = -1;
+    size_t row_bytes = buffer->width * sizeof(uint32_t);
+    for (int y = 0; y < buffer->height; y++) {
+        size_t offset = (size_t) y * buffer->stride;
+        if (memcmp((char *) buffer->data + offset, (char *) front_buffer->data + offset, row_bytes) == 0) {
+            continue;
+        }
+        if (top >= 0 && y - bottom > DAMAGE_GAP) {
+            wl_surface_damage_buffer(surface, 0, top, buffer->width, bottom - top + 1);
+            rectangles++;
+            top = -1;
+        }
+        if (top < 0) {
+            top = y;
+        }
+        bottom = y;
     }
-    // If the interface is wl_shell, bind it to the global variable
-    else if (strcmp(interface, "wl_shell") == 0) {
-        shell = wl_registry_bind(registry, id, &wl_shell_interface, 1);
+    if (top >= 0) {
+        wl_surface_damage_buffer(surface, 0, top, buffer->width, bottom - top + 1);
+        rectangles++;
     }
+    return rectangles;
 }
 
-// A function to handle the registry global remove event
-void registry_global_remove(void *data, struct wl_registry *registry, uint32_t id) {
-    // Do nothing
+// A function to handle the frame callback, the compositor is ready for the next frame
+void frame_done(void *data, struct wl_callback *callback, uint32_t time) {
+    wl_callback_destroy(callback);
+    frame_pending = 0;
 }
 
-// A struct to store the registry listener callbacks
-struct wl_registry_listener registry_listener = {
-    .global = registry_global,
-    .global_remove = registry_global_remove,
+// A struct to store the frame callback listener
+const struct wl_callback_listener frame_listener = {
+    .done = frame_done,
 };
 
-// A function to handle the shell surface ping event
-void shell_surface_ping(void *data, struct wl_shell_surface *shell_surface, uint32_t serial) {
-    // Send a pong reply to the compositor
-    wl_shell_surface_pong(shell_surface, serial);
-}
-
-// A function to handle the shell surface configure event
-void shell_surface_configure(void *data, struct wl_shell_surface *shell_surface,
-                             uint32_t edges, int32_t width, int32_t height) {
-    // Do nothing
+// A function to draw the graph into a free buffer and commit it, if it changed
+void draw_graph() {
+    ShmBuffer *buffer = next_buffer();
+    if (buffer == NULL) {
+        // every buffer is still read by the compositor, the graph stays dirty and the release of one wakes the loop
+        return;
+    }
+    if (show_perf) {
+        // frame interval and data points received since the previous frame
+        int64_t frame = perf_now();
+        uint32_t lines = 0;
+        for (int d = 0; d < num_devices; d++) {
+            lines += devices[d].stats.lines;
+        }
+        if (perf_last_frame != 0) {
+            perf_record(PERF_FRAME_INTERVAL, frame - perf_last_frame);
+            perf_samples_per_frame = lines - perf_lines_at_last_frame;
+        }
+        perf_last_frame = frame;
+        perf_lines_at_last_frame = lines;
+    }
+    // Update the graph parameters based on the buffers
+    int64_t probe = show_perf ? perf_now() : 0;
+    update_graph();
+    if (show_perf) {
+        perf_record(PERF_AUTOSCALE, perf_now() - probe);
+        probe = perf_now();
+        perf_transform_time = 0;
+    }
+
+    cairo = buffer->cairo;
+    draw_frame(&shm_renderer);
+    if (show_perf) {
+        perf_record(PERF_TRANSFORM, perf_transform_time);
+        perf_record(PERF_DRAW, perf_now() - probe - perf_transform_time);
+        draw_perf_overlay(&shm_renderer);
+    }
+    cairo_surface_flush(buffer->surface);
+    // the XY and density modes keep drawing while their rasters fade, paced by the frame callbacks
+    dirty = raster_animating();
+
+    int rectangles = damage_changed_rows(buffer);
+    if (rectangles == 0) {
+        // nothing changed on the screen, the buffer is drawn again next time
+        return;
+    }
+    // attach, damage, frame callback and commit are the requests of a frame
+    perf_requests = rectangles + 3;
+    wl_surface_attach(surface, buffer->buffer, 0, 0);
+    struct wl_callback *callback = wl_surface_frame(surface);
+    wl_callback_add_listener(callback, &frame_listener, NULL);
+    wl_surface_commit(surface);
+    buffer->busy = 1;
+    front_buffer = buffer;
+    frame_pending = 1;
 }
 
-// A function to handle the shell surface popup done event
-void shell_surface_popup_done(void *data, struct wl_shell_surface *shell_surface) {
-    // Do nothing
+// A function to answer the ping of the window manager, it considers the window hung otherwise
+void wm_base_ping(void *data, struct xdg_wm_base *xdg_wm_base, uint32_t serial) {
+    xdg_wm_base_pong(xdg_wm_base, serial);
 }
 
-// A struct to store the shell surface listener callbacks
-struct wl_shell_surface_listener shell_surface_listener = {
-    .ping = shell_surface_ping,
-    .configure = shell_surface_configure,
-    .popup_done = shell_surface_popup_done,
+// A struct to store the window manager base listener callbacks
+const struct xdg_wm_base_listener wm_base_listener = {
+    .ping = wm_base_ping,
 };
 
-// A function to create a wayland buffer from a cairo surface
-struct wl_buffer *create_buffer_from_cairo_surface(cairo_surface_t *surface) {
-
-    // Get the width, height and stride of the cairo surface
-    int width = cairo_image_surface_get_width(surface);
-    int height = cairo_image_surface_get_height(surface);
-    int stride = cairo_image_surface_get_stride(surface);
-
-    // Get the data pointer of the cairo surface
-    void *data = cairo_image_surface_get_data(surface);
-
-    // Create a wl_shm_pool from the data pointer and the size
-    struct wl_shm_pool *pool = wl_shm_create_pool(display, data, height * stride);
+// A function to handle the configure event of the xdg surface, the window size and states of the toplevel are applied now
+void xdg_surface_configure(void *data, struct xdg_surface *xdg_surface, uint32_t serial) {
+    xdg_surface_ack_configure(xdg_surface, serial);
+    if (configured_width > 0 && configured_height > 0) {
+        graph.width = configured_width;
+        graph.height = configured_height;
+    }
+    configured = 1;
+    dirty = 1;
+}
 
-    // Create a wl_buffer from the wl_shm_pool with the same width, height and format as the cairo surface
-    struct wl_buffer *buffer = wl_shm_pool_create_buffer(pool, 0, width, height, stride, WL_SHM_FORMAT_ARGB8888);
+// A struct to store the xdg surface listener callbacks
+const struct xdg_surface_listener xdg_surface_listener = {
+    .configure = xdg_surface_configure,
+};
 
-    // Destroy the wl_shm_pool
-    wl_shm_pool_destroy(pool);
+// A function to handle the configure event of the toplevel, a size of 0 leaves the size to the plotter
+void toplevel_configure(void *data, struct xdg_toplevel *xdg_toplevel, int32_t width, int32_t height, struct wl_array *states) {
+    configured_width = width;
+    configured_height = height;
+}
 
-    // Return the wl_buffer
-    return buffer;
+// A function to handle the close event of the toplevel
+void toplevel_close(void *data, struct xdg_toplevel *xdg_toplevel) {
+    running = 0;
 }
 
-// A function to draw a graph on a cairo surface from the csv data
-void draw_graph(cairo_surface_t *surface) {
-    // Create a cairo context from the surface
-    cairo_t *cr = cairo_create(surface);
+// A struct to store the toplevel listener callbacks
+const struct xdg_toplevel_listener toplevel_listener = {
+    .configure = toplevel_configure,
+    .close = toplevel_close,
+};
 
-    // Clear the surface with white color
-    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
-    cairo_paint(cr);
+// A function to handle the keymap event, the keys are read as evdev key codes so the keymap is not needed
+void keyboard_keymap(void *data, struct wl_keyboard *wl_keyboard, uint32_t format, int32_t fd, uint32_t size) {
+    close(fd);
+}
 
-    // Set the line width and color for the graph
-    cairo_set_line_width(cr, 2.0);
-    cairo_set_source_rgb(cr, 1.0, 0.0, 0.0); // red
+// A function to handle the keyboard focus entering the surface
+void keyboard_enter(void *data, struct wl_keyboard *wl_keyboard, uint32_t serial, struct wl_surface *surface, struct wl_array *keys) {
+}
 
-    // Find the minimum and maximum x and y values in the csv data
-    double min_x = csv_data[0].x;
-    double max_x = csv_data[0].x;
-    double min_y = csv_data[0].y;
-    double max_y = csv_data[0].y;
-    for (int i = 1; i < csv_data_size; i++) {
-        if (csv_data[i].x < min_x) {
-            min_x = csv_data[i].x;
-        }
-        if (csv_data[i].x > max_x) {
-            max_x = csv_data[i].x;
-        }
-        if (csv_data[i].y < min_y) {
-            min_y = csv_data[i].y;
-        }
-        if (csv_data[i].y > max_y) {
-            max_y = csv_data[i].y;
-        }
+// A function to handle the keyboard focus leaving the surface
+void keyboard_leave(void *data, struct wl_keyboard *wl_keyboard, uint32_t serial, struct wl_surface *surface) {
+}
 
+// A function to handle a key press, q quits, m merges the panes, s shows the statistics, p the timings and x the XY plot
+void keyboard_key(void *data, struct wl_keyboard *wl_keyboard, uint32_t serial, uint32_t time, uint32_t key, uint32_t state) {
+    if (state != WL_KEYBOARD_KEY_STATE_PRESSED) {
+        return;
     }
-
-    // Calculate the scale and offset factors for the x and y axes
-    double scale_x = (GRAPH_WIDTH - 2 * GRAPH_MARGIN) / (max_x - min_x);
-    double offset_x = GRAPH_MARGIN - min_x * scale_x;
-    double scale_y = (GRAPH_HEIGHT - 2 * GRAPH_MARGIN) / (max_y - min_y);
-    double offset_y = GRAPH_MARGIN - min_y * scale_y;
-
-    // Move to the first point in the csv data
-    cairo_move_to(cr, csv_data[0].x * scale_x + offset_x, csv_data[0].y * scale_y + offset_y);
-
-    // Loop through the rest of the csv data and draw lines to each point
-    for (int i = 1; i < csv_data_size; i++) {
-        cairo_line_to(cr, csv_data[i].x * scale_x + offset_x, csv_data[i].y * scale_y + offset_y);
+    switch (key) {
+        case KEY_Q:
+            running = 0;
+            break;
+        case KEY_M:
+            merged_view = !merged_view;
+            break;
+        case KEY_S:
+            show_stats = !show_stats;
+            break;
+        case KEY_X:
+            xy_mode = !xy_mode;
+            density_mode = 0;
+            scope_mode = 0;
+            break;
+        case KEY_D:
+            density_mode = !density_mode;
+            xy_mode = 0;
+            scope_mode = 0;
+            break;
+        case KEY_O:
+            scope_mode = !scope_mode;
+            xy_mode = 0;
+            density_mode = 0;
+            break;
+        case KEY_P:
+            show_perf = !show_perf;
+            memset(perf_stages, 0, sizeof(perf_stages));
+            perf_last_frame = 0;
+            break;
     }
-
-    // Stroke the graph
-    cairo_stroke(cr);
-
-    // Destroy the cairo context
-    cairo_destroy(cr);
+    dirty = 1;
 }
 
-// A function to update the wayland surface with the graph
-void update_surface() {
-    // Create a cairo surface with the same size and format as the wayland surface
-    cairo_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, GRAPH_WIDTH, GRAPH_HEIGHT);
+// A function to handle the modifier state, no key combinations are used
+void keyboard_modifiers(void *data, struct wl_keyboard *wl_keyboard, uint32_t serial, uint32_t depressed, uint32_t latched, uint32_t locked, uint32_t group) {
+}
 
-    // Draw the graph on the cairo surface
-    draw_graph(cairo_surface);
+// A struct to store the keyboard listener callbacks
+const struct wl_keyboard_listener keyboard_listener = {
+    .keymap = keyboard_keymap,
+    .enter = keyboard_enter,
+    .leave = keyboard_leave,
+    .key = keyboard_key,
+    .modifiers = keyboard_modifiers,
+};
 
-    // Create a wayland buffer from the cairo surface
-    buffer = create_buffer_from_cairo_surface(cairo_surface);
+// A function to handle the capabilities of the seat, the keyboard is taken when there is one
+void seat_capabilities(void *data, struct wl_seat *wl_seat, uint32_t capabilities) {
+    if ((capabilities & WL_SEAT_CAPABILITY_KEYBOARD) && keyboard == NULL) {
+        keyboard = wl_seat_get_keyboard(wl_seat);
+        wl_keyboard_add_listener(keyboard, &keyboard_listener, NULL);
+    }
+}
 
-    // Attach the buffer to the wayland surface
-    wl_surface_attach(surface, buffer, 0, 0);
+// A struct to store the seat listener callbacks
+const struct wl_seat_listener seat_listener = {
+    .capabilities = seat_capabilities,
+};
 
-    // Commit the wayland surface
-    wl_surface_commit(surface);
+// A function to handle the registry global event, the interfaces the plotter uses are bound
+void registry_global(void *data, struct wl_registry *registry, uint32_t id, const char *interface, uint32_t version) {
+    if (strcmp(interface, wl_compositor_interface.name) == 0) {
+        compositor_version = version < 4 ? version : 4;
+        compositor = wl_registry_bind(registry, id, &wl_compositor_interface, compositor_version);
+    } else if (strcmp(interface, wl_shm_interface.name) == 0) {
+        shm = wl_registry_bind(registry, id, &wl_shm_interface, 1);
+    } else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+        wm_base = wl_registry_bind(registry, id, &xdg_wm_base_interface, 1);
+        xdg_wm_base_add_listener(wm_base, &wm_base_listener, NULL);
+    } else if (strcmp(interface, wl_seat_interface.name) == 0 && seat == NULL) {
+        seat = wl_registry_bind(registry, id, &wl_seat_interface, 1);
+        wl_seat_add_listener(seat, &seat_listener, NULL);
+    }
+}
 
-    // Flush the display
-    wl_display_flush(display);
+// A function to handle the registry global remove event
+void registry_global_remove(void *data, struct wl_registry *registry, uint32_t id) {
+    // Do nothing
 }
 
-// A function to initialize the wayland display and surface
-int wayland_init() {
+// A struct to store the registry listener callbacks
+const struct wl_registry_listener registry_listener = {
+    .global = registry_global,
+    .global_remove = registry_global_remove,
+};
 
-    // Connect to the wayland display
+// A function to connect to the Wayland display and create the window
+void wayland_init(char *title) {
     display = wl_display_connect(NULL);
     if (display == NULL) {
-        fprintf(stderr, "Failed to connect to the wayland display\n");
-        return -1;
+        fprintf(stderr, "Error: Cannot connect to the Wayland display\n");
+        exit(1);
     }
-
-    // Get the wayland registry
     registry = wl_display_get_registry(display);
-    if (registry == NULL) {
-        fprintf(stderr, "Failed to get the wayland registry\n");
-        return -1;
-    }
-
-    // Add the registry listener callbacks
     wl_registry_add_listener(registry, &registry_listener, NULL);
-
-    // Roundtrip the display to get the global objects
+    // one roundtrip for the globals, one for the events of the objects bound by them
     wl_display_roundtrip(display);
-
-    // Check if the compositor and shell are available
-    if (compositor == NULL || shell == NULL) {
-        fprintf(stderr, "Missing wayland global objects\n");
-        return -1;
+    wl_display_roundtrip(display);
+    if (compositor == NULL || shm == NULL || wm_base == NULL) {
+        fprintf(stderr, "Error: The compositor does not offer wl_compositor, wl_shm and xdg_wm_base\n");
+        exit(1);
     }
-
-    // Create a wayland surface from the compositor
-    surface = wl_compositor_create_surface(compositor);
-    if (surface == NULL) {
-        fprintf(stderr, "Failed to create the wayland surface\n");
-        return -1;
+    if (compositor_version < 4) {
+        fprintf(stderr, "Error: wl_surface.damage_buffer needs wl_compositor version 4, the compositor has %u\n", compositor_version);
+        exit(1);
     }
 
-    // Create a wayland shell surface from the shell and the surface
-    shell_surface = wl_shell_get_shell_surface(shell, surface);
-    if (shell_surface == NULL) {
-        fprintf(stderr, "Failed to create the wayland shell surface\n");
-        return -1;
-    }
-
-    // Add the shell surface listener callbacks
-    wl_shell_surface_add_listener(shell_surface, &shell_surface_listener, NULL);
-
-    // Set the shell surface title
-    wl_shell_surface_set_title(shell_surface, "Graph");
-
-    // Set the shell surface role as a toplevel window
-    wl_shell_surface_set_toplevel(shell_surface);
-
-    // Update the wayland surface with the graph
-    update_surface();
-
-    return 0;
+    surface = wl_compositor_create_surface(compositor);
+    xdg_surface = xdg_wm_base_get_xdg_surface(wm_base, surface);
+    xdg_surface_add_listener(xdg_surface, &xdg_surface_listener, NULL);
+    toplevel = xdg_surface_get_toplevel(xdg_surface);
+    xdg_toplevel_add_listener(toplevel, &toplevel_listener, NULL);
+    xdg_toplevel_set_title(toplevel, title);
+    xdg_toplevel_set_app_id(toplevel, "wayland_plotter");
+    // the initial commit without a buffer asks for the first configure event, the first frame is drawn after it
+    wl_surface_commit(surface);
 }
 
-// A function to clean up the wayland display and surface
+// A function to destroy the window and disconnect from the Wayland display
 void wayland_cleanup() {
-    // Destroy the wayland buffer
-    if (buffer != NULL) {
-        wl_buffer_destroy(buffer);
-    }
-
-    // Destroy the cairo surface
-    if (cairo_surface != NULL) {
-        cairo_surface_destroy(cairo_surface);
-    }
-
-    // Destroy the wayland shell surface
-    if (shell_surface != NULL) {
-        wl_shell_surface_destroy(shell_surface);
-    }
+    for (int b = 0; b < SHM_BUFFERS; b++) {
+        destroy_shm_buffer(&buffers[b]);
+    }
+    destroy_static_layer();
+    if (keyboard != NULL) {
+        wl_keyboard_destroy(keyboard);
+    }
+    if (seat != NULL) {
+        wl_seat_destroy(seat);
+    }
+    xdg_toplevel_destroy(toplevel);
+    xdg_surface_destroy(xdg_surface);
+    wl_surface_destroy(surface);
+    xdg_wm_base_destroy(wm_base);
+    wl_shm_destroy(shm);
+    wl_compositor_destroy(compositor);
+    wl_registry_destroy(registry);
+    wl_display_disconnect(display);
+}
 
-    // Destroy the wayland surface
-    if (surface != NULL) {
-        wl_surface_destroy(surface);
-    }
+// A function to handle SIGINT/SIGTERM, the statistics are printed like on q
+void handle_signal(int signal) {
+    running = 0;
+}
 
-    // Destroy the wayland shell
-    if (shell != NULL) {
-        wl_shell_destroy(shell);
+// A function to read one chunk from a device that poll reported readable and ingest its complete lines
+void read_device(SerialDevice *device) {
+    char chunk[SERIAL_READ_CHUNK];
+    int n = read(device->fd, chunk, sizeof(chunk));
+    // every line completed by this chunk is stamped with one clock read taken right after the read
+    double host_time = host_time_ms();
+    if (n == -1 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+    if (n <= 0) {
+        // end of file or error, the device went away
+        fprintf(stderr, "Error: Cannot read from %s\n", device->name);
+        close_source(device);
+        dirty = 1;
+        return;
+    }
+    int64_t probe = show_perf ? perf_now() : 0;
+    uint32_t lines = device->stats.lines;
+    frame_chunk(device, chunk, n, host_time);
+    if (show_perf) {
+        perf_record(PERF_PARSE, perf_now() - probe);
+    }
+    // the scope mode only redraws when a trigger completed a capture
+    if (device->stats.lines != lines && (!scope_mode || new_capture())) {
+        dirty = 1;
     }
+}
 
-    // Destroy the wayland compositor
-    if (compositor != NULL) {
-        wl_compositor_destroy(compositor);
+// A function to update the per-device line rates and driver counters once per statistics interval
+void update_stats(double host_time) {
+    static double last_stats = 0;
+    if (host_time - last_stats < STATS_INTERVAL * 1000.0) {
+        return;
     }
-
-    // Destroy the wayland registry
-    if (registry != NULL) {
-        wl_registry_destroy(registry);
+    for (int d = 0; d < num_devices; d++) {
+        devices[d].line_rate = (devices[d].stats.lines - devices[d].lines_at_last_stats) / ((host_time - last_stats) / 1000.0);
+        devices[d].lines_at_last_stats = devices[d].stats.lines;
+        read_driver_counters(&devices[d], host_time);
     }
-
-    // Disconnect from the wayland display
-    if (display != NULL) {
-        wl_display_disconnect(display);
-
+    last_stats = host_time;
+    if (!scope_mode) {
+        dirty = 1; // the statistics changed, redraw them
     }
+}
 
-    // Free the global csv data array
-    if (csv_data != NULL) {
-        free(csv_data);
-    }
+// A function to print the command line usage and exit
+void usage(char *program) {
+    fprintf(stderr, "Usage: %s [-b <baud rate>] [-l] [-p] [-a <seconds>] [-w <seconds>] [-X <x field>,<y field>[,<samples>]] [-D <sweep ms>] [-T <trigger>] <color theme number> <serial device> <number of data fields> [<serial device> <number of data fields> ...]\n", program);
+    fprintf(stderr, "       a device is a serial port, or pty:<path>, replay:<recorded CSV file>, tcp:<host>:<port> or unix:<socket path>\n");
+    fprintf(stderr, "       -b sets the baud rate of all devices (default %d), any rate supported by the driver works\n", BAUD_RATE);
+    fprintf(stderr, "       -l switches the serial drivers to their low latency mode\n");
+    fprintf(stderr, "       -p shows the performance overlay from the start, its timings are printed on exit\n");
+    fprintf(stderr, "       -a the value range of a pane shrinks once the data fit into a smaller one that long (default %.0f s), it grows at once\n", AUTOSCALE_HYSTERESIS);
+    fprintf(stderr, "       -w fixes the time window of the x-axis, the data points are reduced to %d min/max buckets across it\n", WINDOW_BUCKETS);
+    fprintf(stderr, "       -X plots one data field against another with fading traces (x toggles), e.g. -X 1,2\n");
+    fprintf(stderr, "       -D shows how often the samples of all data fields hit each pixel of a sweep (d toggles), e.g. -D 20\n");
+    fprintf(stderr, "       -T <field>,<level>[,r|f[,<window ms>[,<pre-trigger %%>[,<holdoff ms>]]]] shows the window around each rising (r) or falling (f)\n"
+                    "          crossing of the level by the field, redrawn only for a new capture (o toggles), e.g. -T 1,0.5,r,20,25\n");
+    fprintf(stderr, "       up to %d devices, press m to toggle stacked panes and merged view, s to show ingest statistics, p to show timings\n", MAX_DEVICES);
+    fprintf(stderr, "       append :us to the number of data fields of a device sending micros() timestamps, e.g. 4:us\n");
+    exit(1);
 }
 
 // The main function
-int main() {
-    // Initialize the serial port
-    if (serial_init() == -1) {
-        fprintf(stderr, "Failed to initialize the serial port\n");
-        return -1;
+int main(int argc, char **argv) {
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    // Get the options, the positional arguments keep their indices after the options are skipped
+    int option;
+    while ((option = getopt(argc, argv, "b:lpa:w:X:D:T:")) != -1) {
+        switch (option) {
+            case 'b':
+                baud_rate = atoi(optarg);
+                if (baud_rate <= 0) {
+                    usage(argv[0]);
+                }
+                break;
+            case 'l':
+                low_latency = 1;
+                break;
+            case 'p':
+                show_perf = 1;
+                break;
+            case 'a':
+                autoscale_hysteresis = atof(optarg);
+                if (autoscale_hysteresis < 0) {
+                    usage(argv[0]);
+                }
+                break;
+            case 'w':
+                parse_window_span(optarg);
+                break;
+            case 'X':
+                parse_xy_mode(optarg);
+                break;
+            case 'D':
+                parse_density_mode(optarg);
+                break;
+            case 'T':
+                parse_scope_mode(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
     }
+    argv[optind - 1] = argv[0];
+    argc -= optind - 1;
+    argv += optind - 1;
+    if (argc < 4 || (argc - 2) % 2 != 0 || (argc - 2) / 2 > MAX_DEVICES) {
+        usage(argv[0]);
+    }
+
+    // Get the devices, then open their sources before connecting to the compositor, like the event plotter
+    color_theme = atoi(argv[1]);
+    num_devices = (argc - 2) / 2;
+    for (int d = 0; d < num_devices; d++) {
+        parse_device(&devices[d], argv[2 + 2 * d], argv[3 + 2 * d]);
+    }
+    for (int d = 0; d < num_devices; d++) {
+        open_source(&devices[d]);
+    }
+    graph.width = WINDOW_WIDTH;
+    graph.height = WINDOW_HEIGHT;
+    // Assign different colors to each data field
+    int colors[MAX_DATA_FIELDS] = {COLOR_RED, COLOR_GREEN, COLOR_BLUE, COLOR_YELLOW, COLOR_MAGENTA, COLOR_CYAN, COLOR_BLACK, COLOR_GRAY};
+    memcpy(graph.colors, colors, sizeof(colors));
+
+    char title[64];
+    snprintf(title, sizeof(title), "%s q to quit. m to merge. ", devices[0].name);
+    wayland_init(title);
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    // One poll() over the Wayland connection and every device, the timeout is the next statistics update
+    struct pollfd fds[MAX_DEVICES + 1];
+    while (running) {
+        // Dispatch the events already queued, then announce the read of the connection so no other reader can take them
+        while (wl_display_prepare_read(display) != 0) {
+            wl_display_dispatch_pending(display);
+        }
+        if (wl_display_flush(display) == -1 && errno != EAGAIN) {
+            wl_display_cancel_read(display);
+            fprintf(stderr, "Error: Lost the connection to the Wayland display\n");
+            break;
+        }
+        fds[0].fd = wl_display_get_fd(display);
+        fds[0].events = POLLIN;
+        for (int d = 0; d < num_devices; d++) {
+            // closed devices have fd -1, poll ignores them
+            fds[d + 1].fd = devices[d].fd;
+            fds[d + 1].events = POLLIN;
+        }
+        int ready = poll(fds, num_devices + 1, (int) (STATS_INTERVAL * 1000));
+        if (ready > 0 && (fds[0].revents & POLLIN)) {
+            wl_display_read_events(display);
+        } else {
+            wl_display_cancel_read(display);
+        }
+        if (wl_display_dispatch_pending(display) == -1) {
+            fprintf(stderr, "Error: Lost the connection to the Wayland display\n");
+            break;
+        }
+        for (int d = 0; ready > 0 && d < num_devices; d++) {
+            if (fds[d + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                read_device(&devices[d]);
+            }
+        }
+        update_stats(host_time_ms());
 
-    // Initialize the wayland display and surface
-    if (wayland_init() == -1) {
-        fprintf(stderr, "Failed to initialize the wayland display and surface\n");
-        return -1;
+        // Draw when the graph changed and the compositor asked for the next frame
+        if (configured && dirty && !frame_pending) {
+            draw_graph();
+        }
     }
 
-    // Create a pthread for reading and parsing csv data from the serial port
-    pthread_t thread;
-    if (pthread_create(&thread, NULL, serial_thread, NULL) != 0) {
-        perror("pthread_create");
-        return -1;
+    // Dump the ingest statistics on exit
+    for (int d = 0; d < num_devices; d++) {
+        read_driver_counters(&devices[d], host_time_ms());
     }
-
-    // Loop until the user presses Ctrl-C
-    while (1) {
-        // Wait for wayland events and dispatch them
-        wl_display_dispatch(display);
-
-        // Update the wayland surface with the graph
-        update_surface();
+    print_ingest_stats(stderr);
+    if (show_perf) {
+        print_perf_stats(stderr);
+    }
+    for (int d = 0; d < num_devices; d++) {
+        close_source(&devices[d]);
     }
-
-    // Cancel and join the pthread
-    pthread_cancel(thread);
-    pthread_join(thread, NULL);
-
-    // Clean up the wayland display and surface
     wayland_cleanup();
-
-    // Close the serial port
-    close(serial_fd);
-
-    // Exit the program with success
     return 0;
 }
-
-// End of the main function